@@ -15,15 +15,50 @@
  */
 
 #include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <portaudio.h>
 
 #include "audio.h"
 #include "util.h"
 
-const float PI = 3.14159f;
+/*
+ * Wavetables are mip-mapped by harmonic count: level l of each waveform
+ * holds harmonics 1 through MAXHARM >> l, sampled at OVERSAMPLE points per
+ * harmonic (but never fewer than MINTABSIZE points). Each table is
+ * followed by copies of its first NGUARD samples so that interpolation
+ * never has to wrap. The tables do not depend on the sample rate, so the
+ * whole bank (under 300 KiB) is generated once and shared by every
+ * Wavebuf.
+ *
+ * Interpolating between table samples leaves images of every harmonic
+ * around multiples of the table's sample rate, which fold back into the
+ * audible range as inharmonic partials. With cubic interpolation and 16
+ * points per harmonic, they stay below -80 dB; linear interpolation at 4
+ * points per harmonic left them at -45 dB.
+ */
+enum { MAXHARM = 512, NLEVELS = 10, MINTABSIZE = 256, OVERSAMPLE = 16, NGUARD = 3 };
+
+/*
+ * A Sinebuf holds as many whole cycles as come closest to a whole number
+ * of samples, up to MAXSINESAMP samples, stopping early once the error in
+ * frequency is below SINETOL (about 0.002 cents).
+ */
+enum { MAXSINESAMP = 65536 };
+static const double SINETOL = 1e-6;
+
 const double MINFREQ = 25, MAXFREQ = 8000;
+const char *const wavenames[NWAVES] = { "sine", "sawtooth", "square", "organ" };
+
+static pthread_once_t wtonce = PTHREAD_ONCE_INIT;
+static float *wtbank;
+static float *wtabs[NWAVES][NLEVELS];
+static size_t wtsizes[NLEVELS];
+
+static double harmamp(int wave, int harm);
+static void wtgen(void);
 
 int
 sbcallback(const void *input, void *output, unsigned long framecnt, const PaStreamCallbackTimeInfo *tminfo, PaStreamCallbackFlags statflags, void *sb)
@@ -45,20 +80,189 @@ sbfill(Sinebuf *sb, float *buf, size_t nframes)
 	}
 }
 
+void
+sbfree(Sinebuf *sb)
+{
+	free(sb->samp);
+}
+
+/*
+ * A single period rounded to whole samples would be badly out of tune at
+ * high frequencies: at 44100 Hz, the 5.5 samples of 8000 Hz become 6, a
+ * semitone and a half flat. So the buffer holds several cycles instead.
+ */
 int
 sbinit(Sinebuf *sb, double freq, double samprate, double volume)
 {
-	double period;
-	size_t i;
+	double period, err, besterr;
+	size_t i, k, n, ncycles;
 
-	if (freq < MINFREQ || freq > MAXFREQ || volume < 0 || volume > 1 || samprate <= 0)
+	if (freq < MINFREQ || freq > MAXFREQ || volume < 0 || volume > 1 || samprate <= 0 || freq >= samprate / 2)
 		return 1;
 
 	period = samprate / freq;
+	ncycles = 1;
 	sb->nsamp = (size_t)round(period);
+	besterr = fabs(sb->nsamp / period - 1);
+	for (k = 2; besterr > SINETOL && k * period <= MAXSINESAMP; k++) {
+		n = (size_t)round(k * period);
+		if ((err = fabs(n / (k * period) - 1)) < besterr) {
+			besterr = err;
+			ncycles = k;
+			sb->nsamp = n;
+		}
+	}
+
 	sb->samp = xmalloc(sb->nsamp * sizeof(*sb->samp));
+	/* Reducing the phase exactly keeps the last cycle as clean as the first. */
 	for (i = 0; i < sb->nsamp; i++)
-		sb->samp[i] = volume * sinf(2 * PI * i / period);
+		sb->samp[i] = volume * sin(2 * M_PI * (double)(i * ncycles % sb->nsamp) / sb->nsamp);
 	sb->pos = 0;
 	return 0;
 }
+
+int
+wbcallback(const void *input, void *output, unsigned long framecnt, const PaStreamCallbackTimeInfo *tminfo, PaStreamCallbackFlags statflags, void *wb)
+{
+	USED(input);
+	USED(tminfo);
+	USED(statflags);
+	wbfill(wb, output, framecnt);
+	return 0;
+}
+
+void
+wbfill(Wavebuf *wb, float *buf, size_t nframes)
+{
+	const float *p;
+	float frac;
+
+	/*
+	 * Catmull-Rom interpolation between p[1] and p[2], so that every
+	 * table is played one sample late, which does not matter.
+	 */
+	while (nframes-- > 0) {
+		p = wb->tab + (size_t)wb->phase;
+		frac = wb->phase - (size_t)wb->phase;
+		*buf++ = wb->volume * (p[1] + 0.5f * frac * (p[2] - p[0] +
+		    frac * (2 * p[0] - 5 * p[1] + 4 * p[2] - p[3] +
+		    frac * (3 * (p[1] - p[2]) + p[3] - p[0]))));
+		wb->phase += wb->incr;
+		if (wb->phase >= wb->tabsize)
+			wb->phase -= wb->tabsize;
+	}
+}
+
+int
+wbinit(Wavebuf *wb, int wave, double freq, double samprate, double volume)
+{
+	if (freq < MINFREQ || freq > MAXFREQ || volume < 0 || volume > 1 || samprate <= 0)
+		return 1;
+	if (!(wb->tab = wtget(wave, freq, samprate, &wb->tabsize)))
+		return 1;
+
+	wb->phase = 0;
+	wb->incr = wb->tabsize * freq / samprate;
+	wb->volume = volume;
+	return 0;
+}
+
+int
+wbwave(const char *name)
+{
+	int i;
+
+	for (i = 0; i < NWAVES; i++)
+		if (!strcmp(name, wavenames[i]))
+			return i;
+	return -1;
+}
+
+const float *
+wtget(int wave, double freq, double samprate, size_t *size)
+{
+	int level;
+
+	if (wave < 0 || wave >= NWAVES || freq <= 0)
+		return NULL;
+	/* Voices may be set up from several threads at once. */
+	pthread_once(&wtonce, wtgen);
+
+	/*
+	 * Pick the richest table whose highest harmonic is still below the
+	 * Nyquist frequency.
+	 */
+	for (level = 0; level < NLEVELS; level++)
+		if ((MAXHARM >> level) * freq < samprate / 2) {
+			if (size)
+				*size = wtsizes[level];
+			return wtabs[wave][level];
+		}
+	return NULL;
+}
+
+static double
+harmamp(int wave, int harm)
+{
+	/* Roughly an organ with the 8', 4', 2 2/3', 2', 1 3/5' and 1' stops drawn. */
+	static const double organ[] = { 0, 1, 0.8, 0.6, 0.5, 0.3, 0, 0, 0.3 };
+
+	switch (wave) {
+	case WSINE:
+		return harm == 1;
+	case WSAW:
+		return 1.0 / harm;
+	case WSQUARE:
+		return harm % 2 ? 1.0 / harm : 0;
+	case WORGAN:
+		return harm < (int)(sizeof(organ) / sizeof(*organ)) ? organ[harm] : 0;
+	}
+	return 0;
+}
+
+static void
+wtgen(void)
+{
+	size_t total, i, size;
+	int wave, level, harm, nharm;
+	double amp, peak, *sine;
+	float *tab;
+
+	total = 0;
+	for (level = 0; level < NLEVELS; level++) {
+		size = OVERSAMPLE * (MAXHARM >> level);
+		wtsizes[level] = size > MINTABSIZE ? size : MINTABSIZE;
+		total += wtsizes[level] + NGUARD;
+	}
+	tab = wtbank = xcalloc(NWAVES * total, sizeof(*wtbank));
+
+	/* The table sizes are powers of 2, so one cycle serves them all. */
+	sine = xmalloc(wtsizes[0] * sizeof(*sine));
+	for (i = 0; i < wtsizes[0]; i++)
+		sine[i] = sin(2 * M_PI * i / wtsizes[0]);
+
+	for (wave = 0; wave < NWAVES; wave++)
+		for (level = 0; level < NLEVELS; level++) {
+			size = wtsizes[level];
+			nharm = MAXHARM >> level;
+			for (harm = 1; harm <= nharm; harm++) {
+				if ((amp = harmamp(wave, harm)) == 0)
+					continue;
+				for (i = 0; i < size; i++)
+					tab[i] += amp * sine[harm * i % size * (wtsizes[0] / size)];
+			}
+
+			peak = 0;
+			for (i = 0; i < size; i++)
+				if (fabs(tab[i]) > peak)
+					peak = fabs(tab[i]);
+			for (i = 0; i < size; i++)
+				tab[i] /= peak;
+			for (i = 0; i < NGUARD; i++)
+				tab[size + i] = tab[i];
+
+			wtabs[wave][level] = tab;
+			tab += size + NGUARD;
+		}
+	free(sine);
+}
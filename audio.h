@@ -14,14 +14,35 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+enum { WSINE, WSAW, WSQUARE, WORGAN, NWAVES };
+
 typedef struct Sinebuf Sinebuf;
+typedef struct Wavebuf Wavebuf;
+
+extern const double MINFREQ, MAXFREQ;
+extern const char *const wavenames[NWAVES];
 
 struct Sinebuf {
-	float *samp; /* precomputed mono sample buffer */
+	float *samp; /* precomputed mono sample buffer of whole cycles */
 	size_t pos; /* current position in the buffer */
 	size_t nsamp; /* number of samples */
 };
 
 int sbcallback(const void *input, void *output, unsigned long framecnt, const PaStreamCallbackTimeInfo *tminfo, PaStreamCallbackFlags statflags, void *sb);
 void sbfill(Sinebuf *sb, float *buf, size_t nframes);
+void sbfree(Sinebuf *sb);
 int sbinit(Sinebuf *sb, double freq, double samprate, double volume);
+
+struct Wavebuf {
+	const float *tab; /* shared band-limited wavetable */
+	size_t tabsize; /* number of samples in the table */
+	double phase; /* current position in the table */
+	double incr; /* table positions to advance per sample */
+	float volume;
+};
+
+int wbcallback(const void *input, void *output, unsigned long framecnt, const PaStreamCallbackTimeInfo *tminfo, PaStreamCallbackFlags statflags, void *wb);
+void wbfill(Wavebuf *wb, float *buf, size_t nframes);
+int wbinit(Wavebuf *wb, int wave, double freq, double samprate, double volume);
+int wbwave(const char *name);
+const float *wtget(int wave, double freq, double samprate, size_t *size);
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Compares the ways of parsing a temperament: from a stream (a file or
+ * fmemopen), from memory and from a mapped file, with and without
+ * borrowed strings. For each, prints the heap allocations and time per
+ * parse, including freeing the result.
+ *
+ * Every allocation made by the parser is counted through the util
+ * allocator hooks, and jansson's through its own. Allocations made inside
+ * stdio are not counted.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <jansson.h>
+
+#include "temperament.h"
+#include "util.h"
+
+enum { STREAM, MEMSTREAM, BUF, BUFBORROW, MAP, MAPBORROW, NMODES };
+
+static const char *const modenames[NMODES] = {
+	"stream", "fmemopen", "buf", "buf-borrow", "map", "map-borrow",
+};
+
+static unsigned long nallocs;
+
+static void *countmalloc(size_t sz);
+static double now(void);
+static int parse(Temperament *t, int mode, const char *path, const char *data, size_t len);
+static char *readfile(const char *path, size_t *len);
+static void usage(void);
+
+int
+main(int argc, char *argv[])
+{
+	Temperament t;
+	char *data;
+	size_t len;
+	long niters, i;
+	double elapsed;
+	int c, mode;
+
+	niters = 1000;
+	while ((c = getopt(argc, argv, "n:")) != -1)
+		switch (c) {
+		case 'n':
+			if ((niters = atol(optarg)) <= 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	if (optind == argc)
+		usage();
+	setalloc(countmalloc, free);
+	json_set_alloc_funcs(countmalloc, free);
+
+	for (; optind < argc; optind++) {
+		data = readfile(argv[optind], &len);
+		for (mode = 0; mode < NMODES; mode++) {
+			nallocs = 0;
+			elapsed = now();
+			for (i = 0; i < niters; i++) {
+				if (parse(&t, mode, argv[optind], data, len))
+					die("could not parse '%s'", argv[optind]);
+				tfreefields(&t);
+			}
+			elapsed = now() - elapsed;
+			printf("%-10s %8.1f allocs %10.2f us  %s\n", modenames[mode],
+			    (double)nallocs / niters, elapsed / niters * 1e6, argv[optind]);
+		}
+		free(data);
+	}
+	return 0;
+}
+
+static void *
+countmalloc(size_t sz)
+{
+	nallocs++;
+	return malloc(sz);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+parse(Temperament *t, int mode, const char *path, const char *data, size_t len)
+{
+	FILE *input;
+	int retval;
+
+	switch (mode) {
+	case STREAM:
+	case MEMSTREAM:
+		if (mode == STREAM)
+			input = fopen(path, "r");
+		else
+			input = fmemopen((void *)data, len, "r");
+		if (!input)
+			die("could not open '%s'", path);
+		retval = tparse(t, input, NULL, 0);
+		fclose(input);
+		return retval;
+	case BUF:
+		return tparsebuf(t, data, len, 0, NULL, 0);
+	case BUFBORROW:
+		return tparsebuf(t, data, len, TBORROW, NULL, 0);
+	case MAP:
+		return tparsemap(t, path, 0, NULL, 0);
+	default:
+		return tparsemap(t, path, TBORROW, NULL, 0);
+	}
+}
+
+static char *
+readfile(const char *path, size_t *len)
+{
+	FILE *input;
+	char *data;
+	size_t cap;
+
+	if (!(input = fopen(path, "r")))
+		die("could not open '%s'", path);
+	cap = 4096;
+	data = xmalloc(cap);
+	*len = 0;
+	while ((*len += fread(data + *len, 1, cap - *len, input)) == cap)
+		if (!(data = realloc(data, cap *= 2)))
+			die("out of memory");
+	if (ferror(input))
+		die("could not read '%s'", path);
+	fclose(input);
+	return data;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: parse [-n iterations] file...\n");
+	exit(2);
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+ncpu=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+
+# Candidates evaluated per second by ttopt should scale with the thread count.
+j=1
+while [ "$j" -le "$ncpu" ]; do
+	../ttopt -v -c 256 -j "$j" -s 1 ../test/print-cases/equal.json.in ../test/opt-cases/thirds.txt 2>&1 >/dev/null
+	if [ "$j" -lt "$ncpu" ] && [ $((j * 2)) -gt "$ncpu" ]; then
+		j=$ncpu
+	else
+		j=$((j * 2))
+	fi
+done
+
+# Allocations and time per parse for each entry point, on typical
+# temperaments and on the longest allowed one.
+dir=$(mktemp -d temperatune.XXXXXX)
+awk 'BEGIN {
+	printf "{\"name\":\"chain\",\"octaveBaseName\":\"N0\",\"referencePitch\":440,"
+	printf "\"referenceName\":\"N0\",\"referenceOctave\":4,\"notes\":{\"N0\":[\"N0\",0]"
+	for (i = 1; i < 1024; i++)
+		printf ",\"N%d\":[\"N%d\",1.5]", i, i - 1
+	printf "}}\n"
+}' >"$dir/chain.json"
+./parse ../test/print-cases/equal.json.in ../test/print-cases/qcm.json.in
+./parse -n 20 "$dir/chain.json"
+rm -r "$dir"
+
+# Files checked per second by ttcheck, over a repository of many copies of
+# the print-cases.
+dir=$(mktemp -d temperatune.XXXXXX)
+i=0
+while [ "$i" -lt 200 ]; do
+	mkdir "$dir/$i"
+	for input in ../test/print-cases/*.in; do
+		cp "$input" "$dir/$i/$(basename "$input" .in)"
+	done
+	i=$((i + 1))
+done
+../ttcheck -j 1 "$dir" >/dev/null
+../ttcheck "$dir" >/dev/null
+rm -r "$dir"
+
+# Retuning a keyboard map to a new reference pitch.
+./view ../test/print-cases/qcm.json.in
+
+# The cost of exact ratios against cents on a 32 by 32 five-limit lattice
+# of fifths and major thirds.
+dir=$(mktemp -d temperatune.XXXXXX)
+lattice() {
+	awk -v unison="$1" -v fifth="$2" -v third="$3" 'BEGIN {
+		printf "{\"name\":\"lattice\",\"octaveBaseName\":\"P0_0\",\"referencePitch\":440,"
+		printf "\"referenceName\":\"P0_0\",\"referenceOctave\":4,\"notes\":{\"P0_0\":[\"P0_0\",%s]", unison
+		for (i = 0; i < 32; i++)
+			for (j = 0; j < 32; j++)
+				if (j > 0)
+					printf ",\"P%d_%d\":[\"P%d_%d\",%s]", i, j, i, j - 1, third
+				else if (i > 0)
+					printf ",\"P%d_%d\":[\"P%d_%d\",%s]", i, j, i - 1, j, fifth
+		printf "}}\n"
+	}'
+}
+lattice '"1"' '"3/2"' '"5/4"' >"$dir/ratios.json"
+lattice 0 701.9550008654 386.3137138648 >"$dir/cents.json"
+./parse -n 5 "$dir/ratios.json" "$dir/cents.json"
+./view "$dir/ratios.json"
+./view "$dir/cents.json"
+rm -r "$dir"
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Compares retuning a whole keyboard map to a new reference pitch through
+ * a view against recomputing every pitch with tgetpitch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "temperament.h"
+#include "view.h"
+#include "util.h"
+
+enum { LOWOCTAVE = 0, HIGHOCTAVE = 8, NITERS = 2000 };
+
+static const double refpitches[] = { 415, 430, 440, 442 };
+enum { NPITCHES = sizeof(refpitches) / sizeof(*refpitches) };
+
+static double now(void);
+
+int
+main(int argc, char *argv[])
+{
+	FILE *input;
+	Temperament t;
+	Tview v;
+	char **names, errbuf[256];
+	size_t nnames, i, n;
+	double sum, elapsed;
+	const double *freq;
+	int oct;
+	long iter;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: view temperament\n");
+		return 2;
+	}
+	if (!(input = fopen(argv[1], "r")))
+		die("could not open '%s'", argv[1]);
+	if (tparse(&t, input, errbuf, sizeof(errbuf)))
+		die("%s", errbuf);
+	fclose(input);
+	nnames = ntabsize(&t.notes);
+	names = xmalloc(nnames * sizeof(*names));
+	ntabstorenames(&t.notes, names);
+
+	/* The sums keep the work from being optimized away. */
+	sum = 0;
+	elapsed = now();
+	for (iter = 0; iter < NITERS; iter++) {
+		t.refpitch = refpitches[iter % NPITCHES];
+		for (oct = LOWOCTAVE; oct <= HIGHOCTAVE; oct++)
+			for (i = 0; i < nnames; i++)
+				sum += tgetpitch(&t, names[i], oct);
+	}
+	elapsed = now() - elapsed;
+	printf("tgetpitch %10.2f us per retuning (%.0f)\n", elapsed / NITERS * 1e6, sum);
+
+	if (tvinit(&v, &t, LOWOCTAVE, HIGHOCTAVE))
+		die("could not make a view");
+	sum = 0;
+	elapsed = now();
+	for (iter = 0; iter < NITERS; iter++) {
+		tvsetpitch(&v, refpitches[iter % NPITCHES]);
+		freq = tvtable(&v);
+		for (n = 0; n < v.size; n++)
+			sum += freq[n];
+	}
+	elapsed = now() - elapsed;
+	printf("view      %10.2f us per retuning (%.0f)\n", elapsed / NITERS * 1e6, sum);
+
+	tvfree(&v);
+	for (i = 0; i < nnames; i++)
+		free(names[i]);
+	free(names);
+	tfreefields(&t);
+	return 0;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "temperament.h"
+#include "interval.h"
+#include "util.h"
+
+const int justratios[NJUST][2] = {
+	{ 1, 1 }, { 16, 15 }, { 9, 8 }, { 6, 5 }, { 5, 4 }, { 4, 3 }, { 45, 32 },
+	{ 3, 2 }, { 8, 5 }, { 5, 3 }, { 9, 5 }, { 15, 8 }, { 2, 1 },
+};
+
+static double justcents[NJUST];
+
+static void ivgrow(Ivtab *iv, size_t nnotes);
+static void ivfreenames(Ivtab *iv);
+
+/*
+ * Computes every interval with its lower note in the given octave. The
+ * upper note of each interval is the next occurrence of that note above
+ * the lower one, so a note paired with itself gives an octave. Each
+ * note's frequency is computed once; the upper note of an interval is
+ * the same frequency, doubled if the interval wraps past the octave.
+ */
+void
+ivcompute(Ivtab *iv, double refpitch, int octave)
+{
+	size_t i, j, n;
+	double lower, c, *freqs, *cents, *dev, *beats;
+	int *just, wrap;
+
+	n = iv->nnotes;
+	freqs = iv->freqs;
+	for (i = 0; i < n; i++)
+		freqs[i] = refpitch * exp2((iv->offsets[i] + (octave - iv->refoctave) * OCTAVE_CENTS) / OCTAVE_CENTS);
+
+	for (i = 0; i < n; i++) {
+		cents = iv->cents + i * n;
+		dev = iv->dev + i * n;
+		beats = iv->beats + i * n;
+		just = iv->just + i * n;
+		lower = freqs[i];
+
+		/* beats holds the frequency of the upper note until the loop below. */
+		for (j = 0; j < n; j++) {
+			c = iv->offsets[j] - iv->offsets[i];
+			wrap = c < 0 || j == i;
+			cents[j] = c + wrap * OCTAVE_CENTS;
+			just[j] = (int)(cents[j] / 100 + 0.5);
+			beats[j] = freqs[j] * (1 + wrap);
+		}
+		for (j = 0; j < n; j++) {
+			dev[j] = cents[j] - justcents[just[j]];
+			/*
+			 * For a just ratio p/q, the pth partial of the lower note
+			 * beats against the qth partial of the upper note.
+			 */
+			beats[j] = fabs(justratios[just[j]][1] * beats[j] - justratios[just[j]][0] * lower);
+		}
+	}
+}
+
+void
+ivfree(Ivtab *iv)
+{
+	ivfreenames(iv);
+	free(iv->names);
+	free(iv->offsets);
+	free(iv->freqs);
+	free(iv->cents);
+	free(iv->dev);
+	free(iv->beats);
+	free(iv->just);
+}
+
+void
+ivload(Ivtab *iv, Temperament *t)
+{
+	size_t i;
+	int k;
+
+	if (justcents[NJUST - 1] == 0)
+		for (k = 0; k < NJUST; k++)
+			justcents[k] = OCTAVE_CENTS * log2((double)justratios[k][0] / justratios[k][1]);
+
+	ivfreenames(iv);
+	ivgrow(iv, ntabsize(&t->notes));
+	ntabstorenames(&t->notes, iv->names);
+	ntabsortnames(&t->notes, iv->names, iv->nnotes);
+	for (i = 0; i < iv->nnotes; i++)
+		ntabget(&t->notes, iv->names[i], &iv->offsets[i]);
+	iv->refoctave = t->refoctave;
+}
+
+static void
+ivgrow(Ivtab *iv, size_t nnotes)
+{
+	if (nnotes > iv->cap) {
+		iv->nnotes = 0;
+		ivfree(iv);
+		iv->cap = nnotes;
+		iv->names = xcalloc(nnotes, sizeof(*iv->names));
+		iv->offsets = xmalloc(nnotes * sizeof(*iv->offsets));
+		iv->freqs = xmalloc(nnotes * sizeof(*iv->freqs));
+		iv->cents = xmalloc(nnotes * nnotes * sizeof(*iv->cents));
+		iv->dev = xmalloc(nnotes * nnotes * sizeof(*iv->dev));
+		iv->beats = xmalloc(nnotes * nnotes * sizeof(*iv->beats));
+		iv->just = xmalloc(nnotes * nnotes * sizeof(*iv->just));
+	}
+	iv->nnotes = nnotes;
+}
+
+static void
+ivfreenames(Ivtab *iv)
+{
+	size_t i;
+
+	for (i = 0; i < iv->nnotes; i++) {
+		free(iv->names[i]);
+		iv->names[i] = NULL;
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+enum { NJUST = 13 };
+
+typedef struct Ivtab Ivtab;
+
+/* Just ratios (numerator, denominator) for each interval from 0 to 12 semitones. */
+extern const int justratios[NJUST][2];
+
+/*
+ * A table of every interval between two notes of a temperament. The notes
+ * are sorted by pitch and each result is kept in its own array, indexed
+ * by lower * nnotes + upper, so that one temperament's results are a few
+ * contiguous runs of memory that can be reused for the next. An Ivtab
+ * must be zeroed before it is first loaded.
+ */
+struct Ivtab {
+	size_t nnotes;
+	size_t cap; /* number of notes the arrays can hold */
+	char **names; /* note names, in ascending order of pitch */
+	double *offsets; /* offsets from the reference note, in cents */
+	int refoctave; /* octave number of the reference note */
+	double *freqs; /* frequency of each note in the octave last computed, in Hz */
+	double *cents; /* interval sizes, in cents */
+	double *dev; /* deviation from the nearest just interval, in cents */
+	double *beats; /* beat rates, in Hz */
+	int *just; /* index of the nearest just interval in justratios */
+};
+
+void ivcompute(Ivtab *iv, double refpitch, int octave);
+void ivfree(Ivtab *iv);
+void ivload(Ivtab *iv, Temperament *t);
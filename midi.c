@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "temperament.h"
+#include "midi.h"
+#include "util.h"
+
+enum { DEVICE = 0x7f }; /* the "all call" device ID */
+enum { DIVISION = 480 }; /* ticks per quarter note */
+
+typedef struct Buf Buf;
+
+struct Buf {
+	unsigned char *data;
+	size_t len;
+	size_t cap;
+};
+
+static void bufadd(Buf *b, const void *data, size_t len);
+static void bufbyte(Buf *b, int c);
+static void bufvarlen(Buf *b, unsigned long n);
+
+static void mtsfreq(double freq, unsigned char *out);
+
+void
+ktfree(Keytab *kt)
+{
+	free(kt->names);
+}
+
+/*
+ * Computes the frequency of every key once, so that retuning a whole
+ * keyboard takes one exp2 per key instead of a lookup and a pow.
+ */
+int
+ktinit(Keytab *kt, Temperament *t, double refpitch)
+{
+	double *offsets;
+	long keyoff, oct;
+	size_t deg, i;
+	int key;
+
+	if ((kt->nnotes = ntabsize(&t->notes)) == 0)
+		return 1;
+	kt->names = xmalloc(kt->nnotes * sizeof(*kt->names));
+	tdegrees(t, kt->names);
+
+	offsets = xmalloc(kt->nnotes * sizeof(*offsets));
+	for (i = 0; i < kt->nnotes; i++)
+		ntabget(&t->notes, kt->names[i], &offsets[i]);
+
+	for (key = 0; key < NKEYS; key++) {
+		keyoff = key - MIDDLEKEY;
+		oct = keyoff / (long)kt->nnotes;
+		if (keyoff % (long)kt->nnotes < 0)
+			oct--;
+		deg = keyoff - oct * (long)kt->nnotes;
+		oct += MIDDLEOCTAVE - t->refoctave;
+		kt->freq[key] = refpitch * exp2(offsets[deg] / OCTAVE_CENTS + oct);
+	}
+	free(offsets);
+	return 0;
+}
+
+/* Returns the key that plays the note in the octave, or -1 if none does. */
+int
+ktkey(Keytab *kt, const char *note, int octave)
+{
+	size_t deg;
+	long key;
+
+	for (deg = 0; deg < kt->nnotes; deg++)
+		if (!strcmp(kt->names[deg], note))
+			break;
+	if (deg == kt->nnotes)
+		return -1;
+	key = MIDDLEKEY + ((long)octave - MIDDLEOCTAVE) * (long)kt->nnotes + (long)deg;
+	return key >= 0 && key < NKEYS ? key : -1;
+}
+
+/*
+ * Stores a non-real-time bulk tuning dump for every key in buf, which
+ * must have room for MTSBULKSIZE bytes.
+ */
+size_t
+mtsbulk(Keytab *kt, int prog, const char *name, unsigned char *buf)
+{
+	size_t i, len;
+	unsigned char sum;
+	int key;
+
+	len = 0;
+	buf[len++] = 0xf0;
+	buf[len++] = 0x7e;
+	buf[len++] = DEVICE;
+	buf[len++] = 0x08;
+	buf[len++] = 0x01;
+	buf[len++] = prog & 0x7f;
+	for (i = 0; i < 16; i++)
+		buf[len++] = *name && (unsigned char)*name < 0x80 ? *name++ : ' ';
+	for (key = 0; key < NKEYS; key++, len += 3)
+		mtsfreq(kt->freq[key], &buf[len]);
+
+	/* The checksum covers everything between 0xf0 and itself. */
+	sum = 0;
+	for (i = 1; i < len; i++)
+		sum ^= buf[i];
+	buf[len++] = sum & 0x7f;
+	buf[len++] = 0xf7;
+	return len;
+}
+
+/*
+ * Stores a real-time single note tuning change for nkeys keys (at most
+ * MTSMAXNOTES) starting at firstkey in buf, which must have room for
+ * MTSNOTESSIZE(nkeys) bytes.
+ */
+size_t
+mtsnotes(Keytab *kt, int prog, int firstkey, int nkeys, unsigned char *buf)
+{
+	size_t len;
+	int key;
+
+	len = 0;
+	buf[len++] = 0xf0;
+	buf[len++] = 0x7f;
+	buf[len++] = DEVICE;
+	buf[len++] = 0x08;
+	buf[len++] = 0x02;
+	buf[len++] = prog & 0x7f;
+	buf[len++] = nkeys;
+	for (key = firstkey; key < firstkey + nkeys; key++, len += 3) {
+		buf[len++] = key;
+		mtsfreq(kt->freq[key], &buf[len]);
+	}
+	buf[len++] = 0xf7;
+	return len;
+}
+
+/*
+ * Writes a format 0 standard MIDI file that retunes every key with single
+ * note tuning changes and then plays the keys, either one after another
+ * or together as a chord.
+ */
+int
+smfwrite(Keytab *kt, const int *keys, size_t nkeys, int chord, FILE *output)
+{
+	static const unsigned char tempo[] = { 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20 };
+	static const unsigned char end[] = { 0xff, 0x2f, 0x00 };
+	unsigned char msg[MTSNOTESSIZE(NKEYS / 2)], hdr[14];
+	Buf track;
+	size_t i, len;
+	int key;
+
+	memset(&track, 0, sizeof(track));
+	bufbyte(&track, 0);
+	bufadd(&track, tempo, sizeof(tempo));
+	for (key = 0; key < NKEYS; key += NKEYS / 2) {
+		len = mtsnotes(kt, 0, key, NKEYS / 2, msg);
+		bufbyte(&track, 0);
+		bufbyte(&track, 0xf0);
+		bufvarlen(&track, len - 1);
+		bufadd(&track, msg + 1, len - 1);
+	}
+
+	for (i = 0; i < nkeys; i++) {
+		bufvarlen(&track, chord || i == 0 ? 0 : DIVISION);
+		bufbyte(&track, 0x90);
+		bufbyte(&track, keys[i]);
+		bufbyte(&track, 0x60);
+		if (!chord) {
+			bufvarlen(&track, DIVISION);
+			bufbyte(&track, 0x80);
+			bufbyte(&track, keys[i]);
+			bufbyte(&track, 0x40);
+		}
+	}
+	if (chord)
+		for (i = 0; i < nkeys; i++) {
+			bufvarlen(&track, i == 0 ? 4 * DIVISION : 0);
+			bufbyte(&track, 0x80);
+			bufbyte(&track, keys[i]);
+			bufbyte(&track, 0x40);
+		}
+	bufbyte(&track, 0);
+	bufadd(&track, end, sizeof(end));
+
+	memcpy(hdr, "MThd\0\0\0\6\0\0\0\1", 12);
+	hdr[12] = DIVISION >> 8;
+	hdr[13] = DIVISION & 0xff;
+	fwrite(hdr, 1, sizeof(hdr), output);
+	memcpy(hdr, "MTrk", 4);
+	hdr[4] = track.len >> 24;
+	hdr[5] = track.len >> 16 & 0xff;
+	hdr[6] = track.len >> 8 & 0xff;
+	hdr[7] = track.len & 0xff;
+	fwrite(hdr, 1, 8, output);
+	fwrite(track.data, 1, track.len, output);
+	free(track.data);
+	return ferror(output) ? 1 : 0;
+}
+
+static void
+bufadd(Buf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->cap) {
+		b->cap = 2 * (b->len + len);
+		if (!(b->data = realloc(b->data, b->cap)))
+			die("realloc: out of memory");
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void
+bufbyte(Buf *b, int c)
+{
+	unsigned char byte;
+
+	byte = c;
+	bufadd(b, &byte, 1);
+}
+
+static void
+bufvarlen(Buf *b, unsigned long n)
+{
+	unsigned char bytes[5];
+	int i;
+
+	i = sizeof(bytes);
+	bytes[--i] = n & 0x7f;
+	while (n >>= 7)
+		bytes[--i] = 0x80 | (n & 0x7f);
+	bufadd(b, bytes + i, sizeof(bytes) - i);
+}
+
+/*
+ * Encodes a frequency as a key and a 14-bit fraction of a semitone above
+ * it (units of 100/16384 cents). Frequencies that no key can reach are
+ * encoded as "no change", whose encoding the highest representable
+ * frequency must avoid.
+ */
+static void
+mtsfreq(double freq, unsigned char *out)
+{
+	double semis;
+	long key, frac;
+
+	semis = 69 + 12 * log2(freq / 440);
+	key = (long)floor(semis);
+	frac = lround((semis - key) * 16384);
+	if (frac == 16384) {
+		key++;
+		frac = 0;
+	}
+	if (key < 0 || key > 127) {
+		out[0] = out[1] = out[2] = 0x7f;
+		return;
+	}
+	if (key == 127 && frac == 16383)
+		frac = 16382;
+	out[0] = key;
+	out[1] = frac >> 7;
+	out[2] = frac & 0x7f;
+}
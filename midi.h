@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Keys are mapped to notes linearly: the octave base of octave
+ * MIDDLEOCTAVE is on MIDDLEKEY, and each following key plays the next
+ * note of the temperament in order of pitch.
+ */
+enum { MIDDLEKEY = 60, MIDDLEOCTAVE = 4, NKEYS = 128 };
+/* Sizes of MIDI Tuning Standard messages, in bytes. */
+enum { MTSBULKSIZE = 408, MTSMAXNOTES = 127 };
+#define MTSNOTESSIZE(n) (8 + 4 * (n))
+
+typedef struct Keytab Keytab;
+
+/* The frequency of every MIDI key under a temperament. */
+struct Keytab {
+	double freq[NKEYS]; /* in Hz */
+	size_t nnotes; /* keys per octave */
+	char **names; /* note names, in the order they appear on the keys */
+};
+
+void ktfree(Keytab *kt);
+int ktinit(Keytab *kt, Temperament *t, double refpitch);
+int ktkey(Keytab *kt, const char *note, int octave);
+
+size_t mtsbulk(Keytab *kt, int prog, const char *name, unsigned char *buf);
+size_t mtsnotes(Keytab *kt, int prog, int firstkey, int nkeys, unsigned char *buf);
+
+int smfwrite(Keytab *kt, const int *keys, size_t nkeys, int chord, FILE *output);
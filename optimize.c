@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "temperament.h"
+#include "optimize.h"
+#include "pool.h"
+#include "util.h"
+
+typedef struct Worker Worker;
+
+/* The state of one thread, including its scratch buffers. */
+struct Worker {
+	Optimizer *opt;
+	const size_t *movable; /* notes the search may change */
+	size_t nmovable;
+	double *cur; /* current offsets of the chain */
+	double *chainbest; /* best offsets seen in the chain */
+	double *best; /* best offsets seen by this worker */
+	double cost;
+	unsigned long bestchain;
+	unsigned long long nevals;
+};
+
+static void work(void *arg, int worker, size_t chain);
+static double runchain(Worker *w, unsigned long chain);
+
+static unsigned long long splitmix(unsigned long long *state);
+static double uniform(unsigned long long *state);
+
+double
+optcost(const Target *targets, size_t ntargets, const double *offsets)
+{
+	size_t i;
+	double cost, size, err;
+
+	cost = 0;
+	for (i = 0; i < ntargets; i++) {
+		size = offsets[targets[i].upper] - offsets[targets[i].lower];
+		size -= OCTAVE_CENTS * floor(size / OCTAVE_CENTS);
+		if (size == 0)
+			size = OCTAVE_CENTS;
+		err = size - targets[i].cents;
+		cost += targets[i].weight * err * err;
+	}
+	return cost;
+}
+
+int
+optrun(Optimizer *o)
+{
+	Worker *workers, *w;
+	size_t *movable, nmovable, note, j;
+	int i, retval;
+
+	if (o->nnotes == 0 || o->fixed >= o->nnotes || o->nchains == 0 || o->nthreads < 1)
+		return 1;
+
+	/* Notes that no target mentions keep their starting offsets. */
+	movable = xmalloc(o->nnotes * sizeof(*movable));
+	nmovable = 0;
+	for (note = 0; note < o->nnotes; note++) {
+		if (note == o->fixed)
+			continue;
+		for (j = 0; j < o->ntargets; j++)
+			if (o->targets[j].lower == note || o->targets[j].upper == note) {
+				movable[nmovable++] = note;
+				break;
+			}
+	}
+
+	workers = xcalloc(o->nthreads, sizeof(*workers));
+	for (i = 0; i < o->nthreads; i++) {
+		w = &workers[i];
+		w->opt = o;
+		w->movable = movable;
+		w->nmovable = nmovable;
+		w->cur = xmalloc(o->nnotes * sizeof(*w->cur));
+		w->chainbest = xmalloc(o->nnotes * sizeof(*w->chainbest));
+		w->best = xmalloc(o->nnotes * sizeof(*w->best));
+		w->cost = HUGE_VAL;
+	}
+
+	poolrun(o->nthreads, o->nchains, work, workers);
+
+	o->nevals = 0;
+	w = NULL;
+	for (i = 0; i < o->nthreads; i++) {
+		o->nevals += workers[i].nevals;
+		if (workers[i].cost == HUGE_VAL)
+			continue;
+		if (!w || workers[i].cost < w->cost || (workers[i].cost == w->cost && workers[i].bestchain < w->bestchain))
+			w = &workers[i];
+	}
+	retval = 1;
+	if (w) {
+		o->cost = w->cost;
+		memcpy(o->best, w->best, o->nnotes * sizeof(*o->best));
+		retval = 0;
+	}
+
+	for (i = 0; i < o->nthreads; i++) {
+		free(workers[i].cur);
+		free(workers[i].chainbest);
+		free(workers[i].best);
+	}
+	free(workers);
+	free(movable);
+	return retval;
+}
+
+/* Runs a chain, keeping its result if it is the worker's best so far. */
+static void
+work(void *arg, int worker, size_t chain)
+{
+	Worker *w;
+	double cost;
+
+	w = (Worker *)arg + worker;
+	cost = runchain(w, chain);
+	if (cost < w->cost || (cost == w->cost && chain < w->bestchain)) {
+		w->cost = cost;
+		w->bestchain = chain;
+		memcpy(w->best, w->chainbest, w->opt->nnotes * sizeof(*w->best));
+	}
+}
+
+/*
+ * Runs one annealing chain, leaving its best offsets in w->chainbest and
+ * returning their cost. Each candidate moves a single note, with the step
+ * size and temperature both shrinking as the chain goes on. Every chain
+ * but the first starts from a random jitter of the starting offsets.
+ */
+static double
+runchain(Worker *w, unsigned long chain)
+{
+	Optimizer *o;
+	unsigned long long rng;
+	unsigned long it;
+	size_t i, note;
+	double cost, bestcost, newcost, prev, progress, step, temp;
+
+	o = w->opt;
+	rng = o->seed ^ (0x9e3779b97f4a7c15ULL * (chain + 1));
+	splitmix(&rng);
+
+	memcpy(w->cur, o->start, o->nnotes * sizeof(*w->cur));
+	if (chain > 0)
+		for (i = 0; i < w->nmovable; i++)
+			w->cur[w->movable[i]] += 100 * (uniform(&rng) - 0.5);
+	cost = bestcost = optcost(o->targets, o->ntargets, w->cur);
+	memcpy(w->chainbest, w->cur, o->nnotes * sizeof(*w->cur));
+	w->nevals++;
+	if (w->nmovable == 0)
+		return cost;
+
+	for (it = 0; it < o->niters; it++) {
+		progress = (double)it / o->niters;
+		step = 20 * (1 - progress) + 0.01;
+		temp = 10 * pow(1e-4, progress);
+
+		note = w->movable[(size_t)(uniform(&rng) * w->nmovable)];
+		prev = w->cur[note];
+		w->cur[note] += step * (2 * uniform(&rng) - 1);
+		newcost = optcost(o->targets, o->ntargets, w->cur);
+		w->nevals++;
+
+		if (newcost <= cost || uniform(&rng) < exp((cost - newcost) / temp)) {
+			cost = newcost;
+			if (cost < bestcost) {
+				bestcost = cost;
+				memcpy(w->chainbest, w->cur, o->nnotes * sizeof(*w->cur));
+			}
+		} else {
+			w->cur[note] = prev;
+		}
+	}
+	return bestcost;
+}
+
+static unsigned long long
+splitmix(unsigned long long *state)
+{
+	unsigned long long z;
+
+	z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* Returns a uniformly distributed number in [0, 1). */
+static double
+uniform(unsigned long long *state)
+{
+	return (splitmix(state) >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+typedef struct Optimizer Optimizer;
+typedef struct Target Target;
+
+/* A desired interval between two notes, which are given as indices. */
+struct Target {
+	size_t lower;
+	size_t upper;
+	double cents; /* desired size, in (0, OCTAVE_CENTS] */
+	double weight;
+};
+
+/*
+ * A search for note offsets that best fit a set of target intervals. The
+ * search runs nchains independent annealing chains of niters candidates
+ * each, spread over nthreads threads. Each chain draws from its own
+ * random stream derived from the seed, and ties between chains go to the
+ * lower-numbered one, so the result depends only on the seed and not on
+ * the number of threads.
+ */
+struct Optimizer {
+	size_t nnotes;
+	size_t fixed; /* index of the note whose offset may not change */
+	const double *start; /* starting offsets, in cents */
+	const Target *targets;
+	size_t ntargets;
+	unsigned long long seed;
+	unsigned long nchains;
+	unsigned long niters;
+	int nthreads;
+
+	double *best; /* best offsets found, filled in by optrun */
+	double cost; /* cost of the best offsets */
+	unsigned long long nevals; /* number of candidates evaluated */
+};
+
+double optcost(const Target *targets, size_t ntargets, const double *offsets);
+int optrun(Optimizer *o);
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "pool.h"
+#include "util.h"
+
+typedef struct Pool Pool;
+typedef struct Poolworker Poolworker;
+
+struct Pool {
+	pthread_mutex_t lock;
+	size_t next; /* next job to hand out, guarded by lock */
+	size_t njobs;
+	void (*job)(void *arg, int worker, size_t i);
+	void *arg;
+};
+
+struct Poolworker {
+	Pool *pool;
+	int id;
+};
+
+static void *work(void *arg);
+
+/*
+ * Runs job(arg, worker, i) for every i below njobs on up to nthreads
+ * threads. Jobs are handed out in order, one at a time; worker is the
+ * index (below nthreads) of the thread running the job, so callers can
+ * keep per-thread scratch space in an array. If no thread can be
+ * started, the jobs are run on the calling thread as worker 0.
+ */
+int
+poolrun(int nthreads, size_t njobs, void (*job)(void *arg, int worker, size_t i), void *arg)
+{
+	Pool pool;
+	Poolworker *workers;
+	pthread_t *threads;
+	int i, nstarted;
+
+	if (nthreads < 1)
+		return 1;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pool.next = 0;
+	pool.njobs = njobs;
+	pool.job = job;
+	pool.arg = arg;
+	threads = xcalloc(nthreads, sizeof(*threads));
+	workers = xcalloc(nthreads, sizeof(*workers));
+
+	for (nstarted = 0; nstarted < nthreads; nstarted++) {
+		workers[nstarted].pool = &pool;
+		workers[nstarted].id = nstarted;
+		if (pthread_create(&threads[nstarted], NULL, work, &workers[nstarted]))
+			break;
+	}
+	if (nstarted == 0) {
+		workers[0].pool = &pool;
+		workers[0].id = 0;
+		work(&workers[0]);
+	}
+	for (i = 0; i < nstarted; i++)
+		pthread_join(threads[i], NULL);
+
+	free(workers);
+	free(threads);
+	pthread_mutex_destroy(&pool.lock);
+	return 0;
+}
+
+static void *
+work(void *arg)
+{
+	Poolworker *w;
+	size_t i;
+
+	w = arg;
+	for (;;) {
+		pthread_mutex_lock(&w->pool->lock);
+		i = w->pool->next++;
+		pthread_mutex_unlock(&w->pool->lock);
+		if (i >= w->pool->njobs)
+			break;
+		w->pool->job(w->pool->arg, w->id, i);
+	}
+	return NULL;
+}
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "temperament.h"
+#include "midi.h"
+#include "scala.h"
+#include "util.h"
+
+typedef struct Kbm Kbm;
+
+/* A Scala keyboard mapping. */
+struct Kbm {
+	long size; /* size of the mapping pattern, or 0 for a linear mapping */
+	long middle; /* key to which the first entry of the mapping is mapped */
+	long refkey; /* key for which the frequency is given */
+	double freq;
+	long octdeg; /* scale degree of the formal octave */
+	long *map; /* scale degree for each key in the pattern, or -1 */
+};
+
+static const char *chromatic[] = {
+	"C", "C{sharp}", "D", "E{flat}", "E", "F",
+	"F{sharp}", "G", "G{sharp}", "A", "B{flat}", "B",
+};
+
+static void error(char *errbuf, size_t errsize, char *fmt, ...);
+
+static char *nextline(char **line, size_t *linesize, FILE *input);
+static int kbmparse(Kbm *kbm, FILE *input, char *errbuf, size_t errsize);
+static int parsecount(const char *s, unsigned long *n, char **end);
+static int parsepitch(const char *s, double *cents, Ratio *ratio, int *exact);
+static char *toutf8(const char *s);
+
+static long floordiv(long a, long b);
+
+/*
+ * Writes a linear keyboard mapping that puts the octave base of octave
+ * MIDDLEOCTAVE on MIDDLEKEY and gives the reference pitch to the key of
+ * the reference note.
+ */
+int
+kbmdump(Temperament *t, FILE *output)
+{
+	char **names;
+	size_t nnames, refdeg;
+	long refkey;
+
+	if ((nnames = ntabsize(&t->notes)) == 0)
+		return 1;
+	names = xmalloc(nnames * sizeof(*names));
+	refdeg = tdegrees(t, names);
+	free(names);
+
+	refkey = MIDDLEKEY + (long)(t->refoctave - MIDDLEOCTAVE) * (long)nnames + (long)refdeg;
+	if (refkey < 0 || refkey > 127)
+		return 1;
+
+	fprintf(output, "! %s\n", t->name);
+	fprintf(output, "! Size of map:\n0\n");
+	fprintf(output, "! First MIDI note number to retune:\n0\n");
+	fprintf(output, "! Last MIDI note number to retune:\n127\n");
+	fprintf(output, "! Middle note where the first entry of the mapping is mapped to:\n%d\n", MIDDLEKEY);
+	fprintf(output, "! Reference note for which frequency is given:\n%ld\n", refkey);
+	fprintf(output, "! Frequency to tune the above note to:\n%.6lf\n", t->refpitch);
+	fprintf(output, "! Scale degree to consider as formal octave:\n%zu\n", nnames);
+	fprintf(output, "! Mapping.\n");
+	return ferror(output) ? 1 : 0;
+}
+
+/*
+ * Writes the temperament as a Scala scale whose first degree is the
+ * octave base. Each pitch is followed by the name of its note, which
+ * Scala ignores. Pitches are ratios if the temperament is exact and every
+ * ratio can be written, and cents otherwise.
+ */
+int
+scldump(Temperament *t, FILE *output)
+{
+	char **names, ratio[64];
+	size_t nnames, i;
+	Ratio *rels;
+	const Ratio *base;
+	int exact, k;
+
+	if ((nnames = ntabsize(&t->notes)) == 0)
+		return 1;
+	names = xmalloc(nnames * sizeof(*names));
+	tdegrees(t, names);
+
+	/* Ratios to the octave base, which tnormalize puts within an octave. */
+	rels = xmalloc(nnames * sizeof(*rels));
+	base = &ntablookup(&t->notes, names[0])->ratio;
+	exact = t->exact;
+	for (i = 0; i < nnames; i++) {
+		for (k = 0; k < NPRIMES; k++)
+			rels[i].exp[k] = ntablookup(&t->notes, names[i])->ratio.exp[k] - base->exp[k];
+		if (exact)
+			exact = !ratiostr(&rels[i], ratio, sizeof(ratio));
+	}
+
+	fprintf(output, "! Generated by temperatune\n");
+	if (t->desc)
+		fprintf(output, "! %s\n", t->desc);
+	fprintf(output, "%s\n %zu\n!\n", t->name, nnames);
+	for (i = 1; i < nnames; i++) {
+		if (exact) {
+			ratiostr(&rels[i], ratio, sizeof(ratio));
+			fprintf(output, " %s %s\n", ratio, names[i]);
+		} else {
+			fprintf(output, " %.6lf %s\n", ntablookup(&t->notes, names[i])->offset -
+			    ntablookup(&t->notes, names[0])->offset, names[i]);
+		}
+	}
+	fprintf(output, " 2/1 %s\n", names[0]);
+	free(rels);
+	free(names);
+	return ferror(output) ? 1 : 0;
+}
+
+/*
+ * Parses a Scala scale, and optionally a keyboard mapping, into a
+ * temperament whose octave base is the first degree of the scale. Twelve
+ * note scales get the usual note names, counting from the middle key of
+ * the mapping; other scales name their notes by degree. Without a
+ * mapping, the first degree is the reference note, at the pitch of
+ * middle C in equal temperament.
+ */
+int
+sclparse(Temperament *t, FILE *scl, FILE *kbm, char *errbuf, size_t errsize)
+{
+	Kbm map;
+	char *line, *end, name[32];
+	size_t linesize;
+	double *cents;
+	Ratio *ratios;
+	Note *note;
+	long n, k, keyoff, deg, oct;
+	int retval, exact, i;
+
+	line = NULL;
+	linesize = 0;
+	cents = NULL;
+	ratios = NULL;
+	retval = 1;
+	memset(t, 0, sizeof(*t));
+	memset(&map, 0, sizeof(map));
+	map.middle = MIDDLEKEY;
+	map.refkey = MIDDLEKEY;
+	map.freq = 261.6255653;
+
+	if (!nextline(&line, &linesize, scl)) {
+		error(errbuf, errsize, "description not found");
+		goto EXIT;
+	}
+	line[strcspn(line, "\r\n")] = '\0';
+	t->name = toutf8(line);
+
+	if (!nextline(&line, &linesize, scl)) {
+		error(errbuf, errsize, "number of notes not found");
+		goto EXIT;
+	}
+	n = strtol(line, &end, 10);
+	if (end == line || n < 1 || n > MAXNOTES) {
+		error(errbuf, errsize, "bad number of notes");
+		goto EXIT;
+	}
+
+	/*
+	 * Degree n is the period, which must be an octave. The temperament is
+	 * exact if every pitch is a ratio.
+	 */
+	cents = xmalloc((n + 1) * sizeof(*cents));
+	ratios = xcalloc(n + 1, sizeof(*ratios));
+	cents[0] = 0;
+	exact = 1;
+	for (k = 1; k <= n; k++) {
+		if (!nextline(&line, &linesize, scl)) {
+			error(errbuf, errsize, "expected %ld notes, found %ld", n, k - 1);
+			goto EXIT;
+		}
+		if (parsepitch(line, &cents[k], &ratios[k], &exact)) {
+			line[strcspn(line, "\r\n")] = '\0';
+			error(errbuf, errsize, "bad pitch '%s'", line);
+			goto EXIT;
+		}
+	}
+	if (fabs(cents[n] - OCTAVE_CENTS) > 1e-6) {
+		error(errbuf, errsize, "period is not an octave");
+		goto EXIT;
+	}
+
+	if (kbm && kbmparse(&map, kbm, errbuf, errsize))
+		goto EXIT;
+	if (map.size > 0 && map.octdeg != 0 && map.octdeg != n) {
+		error(errbuf, errsize, "formal octave must be the period of the scale");
+		goto EXIT;
+	}
+
+	keyoff = map.refkey - map.middle;
+	if (map.size == 0) {
+		deg = keyoff - floordiv(keyoff, n) * n;
+		oct = floordiv(keyoff, n);
+	} else {
+		deg = map.map[keyoff - floordiv(keyoff, map.size) * map.size];
+		oct = floordiv(keyoff, map.size);
+		if (deg < 0) {
+			error(errbuf, errsize, "reference key is not mapped");
+			goto EXIT;
+		}
+		oct += deg / n;
+		deg %= n;
+	}
+
+	t->refpitch = map.freq;
+	t->refoctave = map.middle / 12 - 1 + oct + (int)floor(cents[deg] / OCTAVE_CENTS);
+	for (k = 0; k < n; k++) {
+		if (n == 12)
+			snprintf(name, sizeof(name), "%s", chromatic[(map.middle + k) % 12]);
+		else
+			snprintf(name, sizeof(name), "%ld", k);
+		if (k == 0)
+			t->octavebase = xstrdup(name);
+		if (k == deg)
+			t->refname = xstrdup(name);
+		ntabadd(&t->notes, name, cents[k] - cents[deg]);
+		note = ntablookup(&t->notes, name);
+		for (i = 0; i < NPRIMES; i++)
+			note->ratio.exp[i] = ratios[k].exp[i] - ratios[deg].exp[i];
+	}
+	t->exact = exact;
+	tnormalize(t);
+	retval = 0;
+
+EXIT:
+	if (retval)
+		tfreefields(t);
+	free(map.map);
+	free(ratios);
+	free(cents);
+	free(line);
+	return retval;
+}
+
+static void
+error(char *errbuf, size_t errsize, char *fmt, ...)
+{
+	va_list args;
+
+	if (!errbuf)
+		return;
+	va_start(args, fmt);
+	vsnprintf(errbuf, errsize, fmt, args);
+	va_end(args);
+}
+
+/* Reads the next line that is not a comment. */
+static char *
+nextline(char **line, size_t *linesize, FILE *input)
+{
+	while (getline(line, linesize, input) != -1)
+		if (**line != '!')
+			return *line;
+	return NULL;
+}
+
+static int
+kbmparse(Kbm *kbm, FILE *input, char *errbuf, size_t errsize)
+{
+	char *line, *end;
+	size_t linesize;
+	long fields[7], i;
+	double freq;
+	int retval;
+
+	line = NULL;
+	linesize = 0;
+	freq = 0;
+	retval = 1;
+
+	for (i = 0; i < 7; i++) {
+		if (!nextline(&line, &linesize, input)) {
+			error(errbuf, errsize, "keyboard mapping is incomplete");
+			goto EXIT;
+		}
+		if (i == 5) {
+			freq = strtod(line, &end);
+			fields[i] = 0;
+		} else {
+			fields[i] = strtol(line, &end, 10);
+		}
+		if (end == line) {
+			error(errbuf, errsize, "bad keyboard mapping field %ld", i + 1);
+			goto EXIT;
+		}
+	}
+	kbm->size = fields[0];
+	kbm->middle = fields[3];
+	kbm->refkey = fields[4];
+	kbm->freq = freq;
+	kbm->octdeg = fields[6];
+	if (kbm->size < 0 || kbm->size > MAXNOTES || kbm->middle < 0 || kbm->middle > 127 ||
+	    kbm->refkey < 0 || kbm->refkey > 127 || kbm->freq <= 0) {
+		error(errbuf, errsize, "keyboard mapping is out of range");
+		goto EXIT;
+	}
+
+	/* Entries missing from the end of the mapping are unmapped. */
+	if (kbm->size > 0) {
+		kbm->map = xmalloc(kbm->size * sizeof(*kbm->map));
+		for (i = 0; i < kbm->size; i++) {
+			kbm->map[i] = -1;
+			if (!nextline(&line, &linesize, input))
+				continue;
+			line[strcspn(line, "\r\n")] = '\0';
+			if (line[strspn(line, " \t")] == 'x')
+				continue;
+			kbm->map[i] = strtol(line, &end, 10);
+			if (end == line || kbm->map[i] < 0) {
+				error(errbuf, errsize, "bad mapping entry '%s'", line);
+				goto EXIT;
+			}
+		}
+	}
+	retval = 0;
+
+EXIT:
+	free(line);
+	return retval;
+}
+
+/*
+ * Parses a Scala pitch: cents if it contains a period, otherwise a ratio
+ * or a whole number. Anything after the pitch is ignored. Clears exact
+ * unless the pitch is a ratio that ratio can hold.
+ */
+static int
+parsepitch(const char *s, double *cents, Ratio *ratio, int *exact)
+{
+	unsigned long num, den;
+	const char *digits;
+	char *end, buf[64];
+	size_t len;
+
+	s += strspn(s, " \t");
+	len = strcspn(s, " \t\r\n");
+	if (len == 0)
+		return 1;
+	if (memchr(s, '.', len)) {
+		/* Only plain decimals: strtod would also take exponents, hex and nan. */
+		digits = s + (*s == '-' || *s == '+');
+		if (strspn(digits, "0123456789.") != len - (digits - s))
+			return 1;
+		*cents = strtod(s, &end);
+		*exact = 0;
+		return end != s + len || !isfinite(*cents);
+	}
+
+	if (parsecount(s, &num, &end))
+		return 1;
+	den = 1;
+	if (*end == '/' && parsecount(end + 1, &den, &end))
+		return 1;
+	if (end != s + len)
+		return 1;
+	*cents = OCTAVE_CENTS * log2((double)num / den);
+	if (len >= sizeof(buf))
+		*exact = 0;
+	else if (*exact) {
+		memcpy(buf, s, len);
+		buf[len] = '\0';
+		*exact = !ratioparse(ratio, buf);
+	}
+	return 0;
+}
+
+/* Parses a positive integer in decimal, as for each part of a ratio. */
+static int
+parsecount(const char *s, unsigned long *n, char **end)
+{
+	if (!isdigit((unsigned char)*s))
+		return 1;
+	errno = 0;
+	*n = strtoul(s, end, 10);
+	return errno != 0 || *n == 0;
+}
+
+/*
+ * Scala files predate UTF-8 and are often in Latin-1, which JSON does not
+ * allow. Strings that are not valid UTF-8 are converted from Latin-1.
+ * Overlong forms, surrogates and code points above U+10FFFF are not valid,
+ * and jansson would reject them.
+ */
+static char *
+toutf8(const char *s)
+{
+	const unsigned char *p;
+	char *ret, *q;
+	unsigned char lo, hi;
+	int ncont;
+
+	for (p = (const unsigned char *)s; *p; p++) {
+		if (*p < 0x80)
+			continue;
+		/* The range allowed for the first continuation byte. */
+		lo = 0x80;
+		hi = 0xbf;
+		if (*p >= 0xc2 && *p <= 0xdf) {
+			ncont = 1;
+		} else if (*p >= 0xe0 && *p <= 0xef) {
+			ncont = 2;
+			if (*p == 0xe0)
+				lo = 0xa0;
+			else if (*p == 0xed)
+				hi = 0x9f;
+		} else if (*p >= 0xf0 && *p <= 0xf4) {
+			ncont = 3;
+			if (*p == 0xf0)
+				lo = 0x90;
+			else if (*p == 0xf4)
+				hi = 0x8f;
+		} else {
+			break;
+		}
+		if (p[1] < lo || p[1] > hi)
+			break;
+		while (ncont-- > 0 && (p[1] & 0xc0) == 0x80)
+			p++;
+		if (ncont >= 0)
+			break;
+	}
+	if (!*p)
+		return xstrdup(s);
+
+	ret = q = xmalloc(2 * strlen(s) + 1);
+	for (p = (const unsigned char *)s; *p; p++)
+		if (*p < 0x80) {
+			*q++ = *p;
+		} else {
+			*q++ = 0xc0 | (*p >> 6);
+			*q++ = 0x80 | (*p & 0x3f);
+		}
+	*q = '\0';
+	return ret;
+}
+
+static long
+floordiv(long a, long b)
+{
+	return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
@@ -14,12 +14,18 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <jansson.h>
 
@@ -33,38 +39,168 @@ struct Notestack {
 	Notestack *next;
 };
 
-static Notestack *nspush(Notestack *ns, const char *name);
+static int nspush(Notestack **ns, const char *name);
 static Notestack *nspop(Notestack *ns, const char **name);
 
 static void error(char *errbuf, size_t errsize, char *fmt, ...);
 
-static int assignoffset(Notetab *ntab, const char *name, double offset, char *errbuf, size_t errsize);
-static int processnote(Notestack **todo, json_t *notedefs, Notetab *ntab, char *errbuf, size_t errsize);
-static int tpopulate(Temperament *t, json_t *root, char *errbuf, size_t errsize);
+static int assignoffset(Notetab *ntab, const char *name, double offset, const Ratio *ratio, char *errbuf, size_t errsize);
+static double defoffset(json_t *pair, Ratio *ratio);
+static int processnote(Notestack **todo, json_t *notedefs, Notetab *ntab, int exact, char *errbuf, size_t errsize);
+static int copystr(char **dst, const char *str, int flags);
+static int tload(Temperament *t, json_t *root, json_error_t *err, int flags, char *errbuf, size_t errsize);
+static int tpopulate(Temperament *t, json_t *root, int flags, char *errbuf, size_t errsize);
 static int tpopulatenotes(Temperament *t, json_t *notedefs, char *errbuf, size_t errsize);
-static int validatenotes(json_t *notedefs, char *errbuf, size_t errsize);
+static int validatenotes(json_t *notedefs, int *exact, char *errbuf, size_t errsize);
 
+static int ntabcopynames(Notetab *ntab);
+static void ntabfree(Notetab *ntab, int freenames);
+static Note *ntabinsert(Notetab *ntab, char *name, double offset);
+
+static int sameoffset(double a, double b);
+static double ratiocents(const Ratio *r);
+static double ratiovalue(const Ratio *r);
+static int sameratio(const Ratio *a, const Ratio *b);
 static unsigned int hash(const char *str);
 
+/*
+ * Offsets closer than this, relative to their size, are considered
+ * equal, which absorbs floating point error from long chains of
+ * definitions.
+ */
+static const double OFFSETTOL = 1e-9;
+
+static const unsigned int primes[NPRIMES] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31 };
+/* The size of each prime as an interval, in cents. */
+static const double primecents[NPRIMES] = {
+	1200, 1901.9550008653873, 2786.3137138648344, 3368.825906469125,
+	4151.317942364757, 4440.527661769311, 4904.955409500407,
+	5097.513016132302, 5428.274347268416, 5829.577194153087,
+	5945.0355724642495,
+};
+
+/*
+ * Stores the note names in ascending order of pitch, starting with the
+ * octave base, records each note's position in its degree, and returns
+ * the index of the reference note. The names array must have room for
+ * every note. The names belong to the temperament and are not copied.
+ */
+size_t
+tdegrees(Temperament *t, char *names[])
+{
+	size_t nnames, i, ref;
+	char *tmp;
+	Note *note;
+	int b;
+
+	nnames = 0;
+	for (b = 0; b < TABSIZE; b++)
+		for (note = t->notes[b]; note; note = note->next)
+			names[nnames++] = note->name;
+	ntabsortnames(&t->notes, names, nnames);
+
+	/* Notes at the same pitch as the octave base may sort before it. */
+	ref = 0;
+	for (i = 0; i < nnames; i++)
+		if (!strcmp(names[i], t->octavebase)) {
+			tmp = names[i];
+			names[i] = names[0];
+			names[0] = tmp;
+		}
+	for (i = 0; i < nnames; i++) {
+		ntablookup(&t->notes, names[i])->degree = i;
+		if (!strcmp(names[i], t->refname))
+			ref = i;
+	}
+	return ref;
+}
+
+/* Functions that may exit are left out of the library, as in util.c. */
+#ifndef TTBUILD
+/*
+ * Writes the temperament in temperatune(5) format, with each note defined
+ * by its offset from the reference note.
+ */
+int
+tdump(Temperament *t, FILE *output)
+{
+	json_t *root, *notes, *pair;
+	char **names, ratio[64];
+	size_t nnames, i;
+	Note *note;
+	int retval, exact;
+
+	root = json_object();
+	json_object_set_new(root, "name", json_string(t->name));
+	if (t->desc)
+		json_object_set_new(root, "description", json_string(t->desc));
+	if (t->src)
+		json_object_set_new(root, "source", json_string(t->src));
+	json_object_set_new(root, "referenceName", json_string(t->refname));
+	json_object_set_new(root, "referencePitch", json_real(t->refpitch));
+	json_object_set_new(root, "referenceOctave", json_integer(t->refoctave));
+	json_object_set_new(root, "octaveBaseName", json_string(t->octavebase));
+
+	notes = json_object();
+	nnames = ntabsize(&t->notes);
+	names = xmalloc(nnames * sizeof(*names));
+	ntabstorenames(&t->notes, names);
+	ntabsortnames(&t->notes, names, nnames);
+	/* Mixing ratios and cents would lose exactness anyway. */
+	exact = t->exact;
+	for (i = 0; i < nnames && exact; i++)
+		exact = !ratiostr(&ntablookup(&t->notes, names[i])->ratio, ratio, sizeof(ratio));
+	for (i = 0; i < nnames; i++) {
+		note = ntablookup(&t->notes, names[i]);
+		pair = json_array();
+		json_array_append_new(pair, json_string(t->refname));
+		if (exact) {
+			ratiostr(&note->ratio, ratio, sizeof(ratio));
+			json_array_append_new(pair, json_string(ratio));
+		} else {
+			json_array_append_new(pair, json_real(note->offset));
+		}
+		json_object_set_new(notes, names[i], pair);
+		ufree(names[i]);
+	}
+	ufree(names);
+	json_object_set_new(root, "notes", notes);
+
+	retval = json_dumpf(root, output, JSON_INDENT(2) | JSON_PRESERVE_ORDER | JSON_REAL_PRECISION(10));
+	if (!retval)
+		fputc('\n', output);
+	json_decref(root);
+	return retval ? 1 : 0;
+}
+#endif
+
 void
 tfreefields(Temperament *t)
 {
-	free(t->name);
-	free(t->desc);
-	free(t->src);
-	free(t->octavebase);
-	free(t->refname);
+	if (t->doc) {
+		ntabfree(&t->notes, 0);
+		json_decref(t->doc);
+		return;
+	}
+	ufree(t->name);
+	ufree(t->desc);
+	ufree(t->src);
+	ufree(t->octavebase);
+	ufree(t->refname);
 	ntabfreenotes(&t->notes);
 }
 
 double
 tgetpitch(Temperament *t, const char *note, int octave)
 {
+	Note *n;
 	double offset;
 
-	if (ntabget(&t->notes, note, &offset))
+	if (!(n = ntablookup(&t->notes, note)))
 		return -1;
-	offset += (octave - t->refoctave) * OCTAVE_CENTS;
+	if (t->exact)
+		return ldexp(t->refpitch * ratiovalue(&n->ratio), octave - t->refoctave);
+	offset = n->offset + (octave - t->refoctave) * OCTAVE_CENTS;
 	return t->refpitch * pow(2, offset / OCTAVE_CENTS);
 }
 
@@ -73,14 +209,35 @@ tnormalize(Temperament *t)
 {
 	double baseoffset, reloffset;
 	Note *note;
-	int i;
+	Ratio base, rel;
+	int i, k;
+
+	if (t->exact) {
+		/*
+		 * The same as below, but moving notes by whole powers of 2 so
+		 * that their ratios stay exact.
+		 */
+		if (!(note = ntablookup(&t->notes, t->octavebase)))
+			return;
+		note->ratio.exp[0] -= (int)ceil(ratiocents(&note->ratio) / OCTAVE_CENTS);
+		base = note->ratio;
+		for (i = 0; i < TABSIZE; i++)
+			for (note = t->notes[i]; note; note = note->next) {
+				for (k = 0; k < NPRIMES; k++)
+					rel.exp[k] = note->ratio.exp[k] - base.exp[k];
+				note->ratio.exp[0] -= (int)floor(ratiocents(&rel) / OCTAVE_CENTS);
+				note->offset = ratiocents(&note->ratio);
+			}
+		return;
+	}
 
 	/* The octave base must be below (or at) the reference pitch. */
-	ntabget(&t->notes, t->octavebase, &baseoffset);
-	baseoffset = fmod(baseoffset, OCTAVE_CENTS);
+	if (!(note = ntablookup(&t->notes, t->octavebase)))
+		return;
+	baseoffset = fmod(note->offset, OCTAVE_CENTS);
 	if (baseoffset > 0)
 		baseoffset -= OCTAVE_CENTS;
-	ntabadd(&t->notes, t->octavebase, baseoffset);
+	note->offset = baseoffset;
 
 	/*
 	 * Make sure all other offsets are above the octave base and within
@@ -99,82 +256,102 @@ tnormalize(Temperament *t)
 int
 tparse(Temperament *t, FILE *input, char *errbuf, size_t errsize)
 {
-	json_t *root;
 	json_error_t err;
-	Temperament tmp;
-	int retval;
 
-	retval = 0;
-	root = json_loadf(input, 0, &err);
-	if (!root) {
-		error(errbuf, errsize, "could not parse input: %s", err.text);
-		retval = 1;
-		goto EXIT;
-	}
+	return tload(t, json_loadf(input, 0, &err), &err, 0, errbuf, errsize);
+}
 
-	retval = tpopulate(&tmp, root, errbuf, errsize);
-	if (retval)
-		goto EXIT;
+/*
+ * Parses a temperament from memory. With TBORROW, the temperament keeps a
+ * reference to the parsed document and its strings point into it rather
+ * than being copied one by one; tfreefields releases the document. Notes
+ * must not be added to a borrowed temperament. The data itself is not
+ * referenced once this returns.
+ */
+int
+tparsebuf(Temperament *t, const char *data, size_t len, int flags, char *errbuf, size_t errsize)
+{
+	json_error_t err;
 
-	*t = tmp;
-	tnormalize(t);
+	return tload(t, json_loadb(data, len, 0, &err), &err, flags, errbuf, errsize);
+}
 
-EXIT:
-	json_decref(root);
+/*
+ * Parses a temperament file by mapping it into memory, as in tparsebuf.
+ * Returns TNOREAD if the file cannot be read at all.
+ */
+int
+tparsemap(Temperament *t, const char *path, int flags, char *errbuf, size_t errsize)
+{
+	struct stat st;
+	void *data;
+	int fd, retval;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		error(errbuf, errsize, "cannot open '%s': %s", path, strerror(errno));
+		return TNOREAD;
+	}
+	if (fstat(fd, &st) == -1) {
+		error(errbuf, errsize, "cannot stat '%s': %s", path, strerror(errno));
+		close(fd);
+		return TNOREAD;
+	}
+	/* Empty files cannot be mapped, but should still fail to parse. */
+	if (st.st_size == 0) {
+		close(fd);
+		return tparsebuf(t, "", 0, flags, errbuf, errsize);
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		error(errbuf, errsize, "cannot map '%s': %s", path, strerror(errno));
+		return TNOREAD;
+	}
+	retval = tparsebuf(t, data, st.st_size, flags, errbuf, errsize);
+	munmap(data, st.st_size);
 	return retval;
 }
 
+#ifndef TTBUILD
 void
 ntabadd(Notetab *ntab, const char *name, double offset)
 {
-	unsigned int bucket;
 	Note *note;
 
-	bucket = hash(name) % TABSIZE;
-	for (note = (*ntab)[bucket]; note; note = note->next)
-		if (!strcmp(name, note->name)) {
-			note->offset = offset;
-			return;
-		}
-
-	note = xmalloc(sizeof(*note));
-	note->name = xstrdup(name);
-	note->offset = offset;
-	note->next = (*ntab)[bucket];
-	(*ntab)[bucket] = note;
-	return;
+	if ((note = ntablookup(ntab, name)))
+		note->offset = offset;
+	else if (!ntabinsert(ntab, xstrdup(name), offset))
+		die("ntabadd: out of memory");
 }
+#endif
 
 void
 ntabfreenotes(Notetab *ntab)
 {
-	Note *note, *next;
-
-	for (int i = 0; i < TABSIZE; i++) {
-		note = (*ntab)[i];
-		while (note) {
-			next = note->next;
-			free(note->name);
-			free(note);
-			note = next;
-		}
-	}
+	ntabfree(ntab, 1);
 }
 
 int
 ntabget(Notetab *ntab, const char *name, double *offset)
 {
-	unsigned int bucket;
 	Note *note;
 
-	bucket = hash(name) % TABSIZE;
-	for (note = (*ntab)[bucket]; note; note = note->next)
-		if (!strcmp(name, note->name)) {
-			if (offset)
-				*offset = note->offset;
-			return 0;
-		}
-	return 1;
+	if (!(note = ntablookup(ntab, name)))
+		return 1;
+	if (offset)
+		*offset = note->offset;
+	return 0;
+}
+
+Note *
+ntablookup(Notetab *ntab, const char *name)
+{
+	Note *note;
+
+	for (note = (*ntab)[hash(name) % TABSIZE]; note; note = note->next)
+		if (!strcmp(name, note->name))
+			return note;
+	return NULL;
 }
 
 size_t
@@ -216,6 +393,7 @@ ntabsortnames(Notetab *ntab, char *names[], size_t nnames)
 		}
 }
 
+#ifndef TTBUILD
 void
 ntabstorenames(Notetab *ntab, char *names[])
 {
@@ -226,16 +404,145 @@ ntabstorenames(Notetab *ntab, char *names[])
 		for (note = (*ntab)[i]; note; note = note->next)
 			*names++ = xstrdup(note->name);
 }
+#endif
 
-static Notestack *
-nspush(Notestack *ns, const char *name)
+/*
+ * Parses a ratio of the form "n/d" or "n", where n and d are positive
+ * integers with no prime factors above 31.
+ */
+int
+ratioparse(Ratio *r, const char *str)
+{
+	unsigned long long n;
+	int k, sign;
+
+	memset(r, 0, sizeof(*r));
+	for (sign = 1; sign >= -1; sign -= 2) {
+		if (*str < '1' || *str > '9')
+			return 1;
+		for (n = 0; *str >= '0' && *str <= '9'; str++) {
+			if (n > (ULLONG_MAX - (*str - '0')) / 10)
+				return 1;
+			n = 10 * n + (*str - '0');
+		}
+		for (k = 0; k < NPRIMES; k++)
+			for (; n % primes[k] == 0; n /= primes[k])
+				r->exp[k] += sign;
+		if (n != 1)
+			return 1;
+		if (*str == '\0')
+			return 0;
+		if (*str++ != '/' || sign < 0)
+			return 1;
+	}
+	return 1;
+}
+
+/* Writes a ratio as "n/d", failing if either part is too large. */
+int
+ratiostr(const Ratio *r, char *buf, size_t size)
+{
+	unsigned long long n, d, *part;
+	int k, e;
+
+	n = d = 1;
+	for (k = 0; k < NPRIMES; k++) {
+		part = r->exp[k] > 0 ? &n : &d;
+		for (e = abs(r->exp[k]); e > 0; e--) {
+			if (*part > ULLONG_MAX / primes[k])
+				return 1;
+			*part *= primes[k];
+		}
+	}
+	snprintf(buf, size, "%llu/%llu", n, d);
+	return 0;
+}
+
+/*
+ * Replaces every name with a copy, so that the table no longer depends on
+ * the document. The copies are made before any name is replaced, so on
+ * failure the names are left as they were.
+ */
+static int
+ntabcopynames(Notetab *ntab)
+{
+	Note *note;
+	size_t n, i;
+	char **copies;
+	int b;
+
+	if (!(copies = umalloc(ntabsize(ntab) * sizeof(*copies))))
+		return 1;
+	n = 0;
+	for (b = 0; b < TABSIZE; b++)
+		for (note = (*ntab)[b]; note; note = note->next)
+			if (!(copies[n++] = ustrdup(note->name)))
+				goto FAIL;
+
+	n = 0;
+	for (b = 0; b < TABSIZE; b++)
+		for (note = (*ntab)[b]; note; note = note->next)
+			note->name = copies[n++];
+	ufree(copies);
+	return 0;
+
+FAIL:
+	for (i = 0; i + 1 < n; i++)
+		ufree(copies[i]);
+	ufree(copies);
+	return 1;
+}
+
+static void
+ntabfree(Notetab *ntab, int freenames)
+{
+	Note *note, *next;
+
+	for (int i = 0; i < TABSIZE; i++) {
+		note = (*ntab)[i];
+		while (note) {
+			next = note->next;
+			if (freenames)
+				ufree(note->name);
+			ufree(note);
+			note = next;
+		}
+	}
+}
+
+/*
+ * Adds a note that is not yet in the table, taking the name as given.
+ * Returns NULL if out of memory.
+ */
+static Note *
+ntabinsert(Notetab *ntab, char *name, double offset)
+{
+	unsigned int bucket;
+	Note *note;
+
+	bucket = hash(name) % TABSIZE;
+	if (!(note = umalloc(sizeof(*note))))
+		return NULL;
+	note->name = name;
+	note->offset = offset;
+	memset(&note->ratio, 0, sizeof(note->ratio));
+	note->degree = 0;
+	note->next = (*ntab)[bucket];
+	(*ntab)[bucket] = note;
+	return note;
+}
+
+static int
+nspush(Notestack **ns, const char *name)
 {
 	Notestack *new;
 
-	new = malloc(sizeof(*new));
+	if (!(new = umalloc(sizeof(*new))))
+		return 1;
 	new->name = name;
-	new->next = ns;
-	return new;
+	new->next = *ns;
+	*ns = new;
+	return 0;
 }
 
 static Notestack *
@@ -245,7 +552,7 @@ nspop(Notestack *ns, const char **name)
 
 	next = ns->next;
 	*name = ns->name;
-	free(ns);
+	ufree(ns);
 	return next;
 }
 
@@ -261,35 +568,75 @@ error(char *errbuf, size_t errsize, char *fmt, ...)
 	va_end(args);
 }
 
+/*
+ * Assigns an offset to a note, or checks it against the one already
+ * assigned. When ratio is given, the ratios must match exactly. Returns
+ * TNOMEM, without setting an error message, if out of memory.
+ */
 static int
-assignoffset(Notetab *ntab, const char *name, double offset, char *errbuf, size_t errsize)
+assignoffset(Notetab *ntab, const char *name, double offset, const Ratio *ratio, char *errbuf, size_t errsize)
 {
-	double prevoffset;
+	Note *prev;
 
-	if (!ntabget(ntab, name, &prevoffset) && fmod(offset - prevoffset, OCTAVE_CENTS) != 0) {
-		error(errbuf, errsize, "found conflicting offset for '%s'", name);
-		return 1;
+	/*
+	 * Keep the first offset found, so that the reference note stays at
+	 * exactly zero.
+	 */
+	if ((prev = ntablookup(ntab, name))) {
+		if (ratio ? !sameratio(ratio, &prev->ratio) : !sameoffset(offset, prev->offset)) {
+			error(errbuf, errsize, "found conflicting offset for '%s'", name);
+			return 1;
+		}
+		return 0;
 	}
-	ntabadd(ntab, name, offset);
+	/* The name belongs to the document until tpopulatenotes copies it. */
+	if (!(prev = ntabinsert(ntab, (char *)name, offset)))
+		return TNOMEM;
+	if (ratio)
+		prev->ratio = *ratio;
 	return 0;
 }
 
+/*
+ * Returns the offset given by a note definition, in cents, storing it in
+ * ratio as well if it is given as a ratio.
+ */
+static double
+defoffset(json_t *pair, Ratio *ratio)
+{
+	json_t *offset;
+
+	offset = json_array_get(pair, 1);
+	if (json_is_number(offset))
+		return json_number_value(offset);
+	ratioparse(ratio, json_string_value(offset));
+	return ratiocents(ratio);
+}
+
 static int
-processnote(Notestack **todo, json_t *notedefs, Notetab *ntab, char *errbuf, size_t errsize)
+processnote(Notestack **todo, json_t *notedefs, Notetab *ntab, int exact, char *errbuf, size_t errsize)
 {
 	const char *currnote, *newnote, *tmp;
-	double curroffset, newoffset;
+	double newoffset;
 	json_t *pair;
+	Note *curr;
+	Ratio def, ratio;
+	int k, err;
 
 	*todo = nspop(*todo, &currnote);
 
-	ntabget(ntab, currnote, &curroffset);
+	curr = ntablookup(ntab, currnote);
 
 	/* Check for the note on the left hand side. */
 	pair = json_object_get(notedefs, currnote);
 	if (pair) {
 		newnote = json_string_value(json_array_get(pair, 0));
-		newoffset = json_number_value(json_array_get(pair, 1));
+		newoffset = curr->offset - defoffset(pair, &def);
+		if (exact) {
+			for (k = 0; k < NPRIMES; k++)
+				ratio.exp[k] = curr->ratio.exp[k] - def.exp[k];
+			newoffset = ratiocents(&ratio);
+		}
 
 		/*
 		 * Make sure not to add the new note as a "todo" if it's already
@@ -297,37 +644,78 @@ processnote(Notestack **todo, json_t *notedefs, Notetab *ntab, char *errbuf, siz
 		 * offset below to detect invalid input (multiple possible values
 		 * for an offset).
 		 */
-		if (ntabget(ntab, newnote, NULL))
-			*todo = nspush(*todo, newnote);
+		if (ntabget(ntab, newnote, NULL) && nspush(todo, newnote))
+			return TNOMEM;
 
-		if (assignoffset(ntab, newnote, curroffset - newoffset, errbuf, errsize))
-			return 1;
+		if ((err = assignoffset(ntab, newnote, newoffset, exact ? &ratio : NULL, errbuf, errsize)))
+			return err;
 	}
 
 	/* Check for the note on the right hand side. */
 	json_object_foreach(notedefs, newnote, pair) {
 		tmp = json_string_value(json_array_get(pair, 0));
 		if (!strcmp(tmp, currnote)) {
-			newoffset = json_number_value(json_array_get(pair, 1));
-			if (ntabget(ntab, newnote, NULL))
-				*todo = nspush(*todo, newnote);
+			newoffset = curr->offset + defoffset(pair, &def);
+			if (exact) {
+				for (k = 0; k < NPRIMES; k++)
+					ratio.exp[k] = curr->ratio.exp[k] + def.exp[k];
+				newoffset = ratiocents(&ratio);
+			}
+			if (ntabget(ntab, newnote, NULL) && nspush(todo, newnote))
+				return TNOMEM;
 
-			if (assignoffset(ntab, newnote, curroffset + newoffset, errbuf, errsize))
-				return 1;
+			if ((err = assignoffset(ntab, newnote, newoffset, exact ? &ratio : NULL, errbuf, errsize)))
+				return err;
 		}
 	}
 
 	return 0;
 }
 
+/* Builds a temperament from a freshly loaded document, taking its reference. */
+static int
+tload(Temperament *t, json_t *root, json_error_t *err, int flags, char *errbuf, size_t errsize)
+{
+	Temperament tmp;
+	int retval;
+
+	if (!root) {
+		error(errbuf, errsize, "could not parse input: %s", err->text);
+		return 1;
+	}
+	retval = tpopulate(&tmp, root, flags, errbuf, errsize);
+	json_decref(root);
+	if (retval)
+		return retval;
+
+	*t = tmp;
+	tnormalize(t);
+	return 0;
+}
+
+/*
+ * Stores a string field, borrowed or copied according to flags. Borrowed
+ * strings are only read, so casting away const is harmless.
+ */
+static int
+copystr(char **dst, const char *str, int flags)
+{
+	*dst = flags & TBORROW ? (char *)str : ustrdup(str);
+	return !*dst;
+}
+
 static int
-tpopulate(Temperament *t, json_t *root, char *errbuf, size_t errsize)
+tpopulate(Temperament *t, json_t *root, int flags, char *errbuf, size_t errsize)
 {
 	json_t *tmp;
 	const char *str;
 	double d;
+	int retval;
 
+	retval = 1;
 	memset(t, 0, sizeof(*t));
+	if (flags & TBORROW)
+		t->doc = json_incref(root);
 
 	if (!json_is_object(root)) {
 		error(errbuf, errsize, "input is not a JSON object");
@@ -338,23 +726,23 @@ tpopulate(Temperament *t, json_t *root, char *errbuf, size_t errsize)
 		error(errbuf, errsize, "name not found");
 		goto FAIL;
 	}
-	t->name = xstrdup(str);
+	if (copystr(&t->name, str, flags))
+		goto NOMEM;
 
-	if ((str = json_string_value(json_object_get(root, "description"))))
-		t->desc = xstrdup(str);
-	else
-		t->desc = NULL;
+	if ((str = json_string_value(json_object_get(root, "description"))) &&
+	    copystr(&t->desc, str, flags))
+		goto NOMEM;
 
-	if ((str = json_string_value(json_object_get(root, "source"))))
-		t->src = xstrdup(str);
-	else
-		t->src = NULL;
+	if ((str = json_string_value(json_object_get(root, "source"))) &&
+	    copystr(&t->src, str, flags))
+		goto NOMEM;
 
 	if (!(str = json_string_value(json_object_get(root, "octaveBaseName")))) {
 		error(errbuf, errsize, "octave base name not found");
 		goto FAIL;
 	}
-	t->octavebase = xstrdup(str);
+	if (copystr(&t->octavebase, str, flags))
+		goto NOMEM;
 
 	tmp = json_object_get(root, "referencePitch");
 	if (!json_is_number(tmp)) {
@@ -372,7 +760,8 @@ tpopulate(Temperament *t, json_t *root, char *errbuf, size_t errsize)
 		error(errbuf, errsize, "reference note name not found");
 		goto FAIL;
 	}
-	t->refname = xstrdup(str);
+	if (copystr(&t->refname, str, flags))
+		goto NOMEM;
 
 	tmp = json_object_get(root, "referenceOctave");
 	if (!json_is_integer(tmp)) {
@@ -385,16 +774,19 @@ tpopulate(Temperament *t, json_t *root, char *errbuf, size_t errsize)
 		error(errbuf, errsize, "notes not found");
 		goto FAIL;
 	}
-	if (validatenotes(tmp, errbuf, errsize))
+	if (validatenotes(tmp, &t->exact, errbuf, errsize))
 		goto FAIL;
 
-	if (tpopulatenotes(t, tmp, errbuf, errsize))
+	if ((retval = tpopulatenotes(t, tmp, errbuf, errsize)))
 		goto FAIL;
 	return 0;
 
+NOMEM:
+	error(errbuf, errsize, "out of memory");
+	retval = TNOMEM;
 FAIL:
 	tfreefields(t);
-	return 1;
+	return retval;
 }
 
 static int
@@ -404,15 +796,21 @@ tpopulatenotes(Temperament *t, json_t *notedefs, char *errbuf, size_t errsize)
 	Notestack *todo;
 	const char *note;
 	json_t *pair;
+	int err;
 
 	memset(&ntab, 0, sizeof(ntab));
-	ntabadd(&ntab, t->refname, 0);
-	todo = nspush(NULL, t->refname);
+	todo = NULL;
+	if (!ntabinsert(&ntab, t->refname, 0) || nspush(&todo, t->refname))
+		goto NOMEM;
 
 	while (todo)
-		if (processnote(&todo, notedefs, &ntab, errbuf, errsize))
+		if ((err = processnote(&todo, notedefs, &ntab, t->exact, errbuf, errsize))) {
+			if (err == TNOMEM)
+				goto NOMEM;
 			goto FAIL;
+		}
 
+	err = 1;
 	/* Ensure we have all the notes we need and none are undefined. */
 	if (ntabget(&ntab, t->octavebase, NULL)) {
 		error(errbuf, errsize, "could not determine offset of octave base '%s'", t->octavebase);
@@ -426,36 +824,103 @@ tpopulatenotes(Temperament *t, json_t *notedefs, char *errbuf, size_t errsize)
 		}
 	}
 
+	/* Until now, every name has pointed into the document. */
+	if (!t->doc && ntabcopynames(&ntab))
+		goto NOMEM;
 	memcpy(&t->notes, &ntab, sizeof(ntab));
 	return 0;
 
+NOMEM:
+	error(errbuf, errsize, "out of memory");
+	err = TNOMEM;
 FAIL:
-	ntabfreenotes(&ntab);
-	return 1;
+	while (todo)
+		todo = nspop(todo, &note);
+	ntabfree(&ntab, 0);
+	return err;
 }
 
+/*
+ * Checks the form of every note definition. The notes can be resolved
+ * exactly if every offset is given as a ratio.
+ */
 static int
-validatenotes(json_t *notedefs, char *errbuf, size_t errsize)
+validatenotes(json_t *notedefs, int *exact, char *errbuf, size_t errsize)
 {
 	const char *note;
-	json_t *pair;
+	json_t *pair, *offset;
+	Ratio ratio;
 
 	if (!json_is_object(notedefs)) {
 		error(errbuf, errsize, "notes must be an object");
 		return 1;
 	}
+	if (json_object_size(notedefs) > MAXNOTES) {
+		error(errbuf, errsize, "too many notes (at most %d are allowed)", MAXNOTES);
+		return 1;
+	}
 
+	*exact = 1;
 	json_object_foreach(notedefs, note, pair) {
+		offset = json_array_get(pair, 1);
 		if (!json_is_array(pair) || json_array_size(pair) != 2 ||
 		    !json_is_string(json_array_get(pair, 0)) ||
-		    !json_is_number(json_array_get(pair, 1))) {
+		    !(json_is_number(offset) || json_is_string(offset))) {
 			error(errbuf, errsize, "note '%s' is defined incorrectly", note);
 			return 1;
 		}
+		if (json_is_number(offset)) {
+			*exact = 0;
+		} else if (ratioparse(&ratio, json_string_value(offset))) {
+			error(errbuf, errsize, "note '%s' has a bad ratio (ratios must be of integers with no prime factor above 31)", note);
+			return 1;
+		}
 	}
 	return 0;
 }
 
+/* Returns whether two offsets name the same note, ignoring octaves. */
+static int
+sameoffset(double a, double b)
+{
+	return fabs(remainder(a - b, OCTAVE_CENTS)) <= OFFSETTOL * (1 + fabs(a) + fabs(b));
+}
+
+/* Returns the size of a ratio, in cents. */
+static double
+ratiocents(const Ratio *r)
+{
+	double cents;
+	int k;
+
+	cents = 0;
+	for (k = NPRIMES - 1; k >= 0; k--)
+		cents += r->exp[k] * primecents[k];
+	return cents;
+}
+
+/* Returns the value of a ratio, which is more precise than going through cents. */
+static double
+ratiovalue(const Ratio *r)
+{
+	double value;
+	int k;
+
+	value = 1;
+	for (k = 1; k < NPRIMES; k++)
+		value *= pow(primes[k], r->exp[k]);
+	if (value == 0 || !isfinite(value))
+		return exp2(ratiocents(r) / OCTAVE_CENTS);
+	return ldexp(value, r->exp[0]);
+}
+
+/* Returns whether two ratios name the same note, ignoring octaves. */
+static int
+sameratio(const Ratio *a, const Ratio *b)
+{
+	return !memcmp(&a->exp[1], &b->exp[1], (NPRIMES - 1) * sizeof(a->exp[0]));
+}
+
 static unsigned int
 hash(const char *str)
 {
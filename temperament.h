@@ -16,9 +16,14 @@
 
 enum { OCTAVE_CENTS = 1200 };
 enum { TABSIZE = 17 };
+enum { MAXNOTES = 1024 }; /* resolving notes takes time quadratic in this */
+enum { TBORROW = 1 }; /* tparsebuf flag: keep the document instead of copying strings */
+enum { TNOMEM = 2, TNOREAD = 3 }; /* parse failures other than 1, a bad temperament */
+enum { NPRIMES = 11 }; /* primes up to 31 may appear in ratios */
 
 typedef struct Temperament Temperament;
 typedef struct Note Note;
+typedef struct Ratio Ratio;
 typedef Note *Notetab[TABSIZE];
 
 struct Temperament {
@@ -30,23 +35,44 @@ struct Temperament {
 	char *refname; /* name of reference note */
 	int refoctave; /* octave number of reference note */
 	Notetab notes;
+	struct json_t *doc; /* parsed document the strings point into, if borrowed */
+	int exact; /* whether every note has an exact ratio */
 };
 
+size_t tdegrees(Temperament *t, char *names[]);
+int tdump(Temperament *t, FILE *output);
 const char *tfindnote(Temperament *t, double pitch, double *offset);
 void tfreefields(Temperament *t);
 double tgetpitch(Temperament *t, const char *note, int octave);
 void tnormalize(Temperament *t);
 int tparse(Temperament *t, FILE *input, char *errbuf, size_t errsize);
+int tparsebuf(Temperament *t, const char *data, size_t len, int flags, char *errbuf, size_t errsize);
+int tparsemap(Temperament *t, const char *path, int flags, char *errbuf, size_t errsize);
+
+/*
+ * A frequency ratio, as the exponents of its prime factors from 2 up, so
+ * that multiplying ratios is adding exponents and octave equivalence is
+ * ignoring the first one.
+ */
+struct Ratio {
+	int exp[NPRIMES];
+};
 
 struct Note {
 	char *name;
 	double offset;
+	Ratio ratio; /* to the reference note; meaningful only in exact temperaments */
+	size_t degree; /* position in ascending order of pitch, as of the last tdegrees */
 	Note *next;
 };
 
 void ntabadd(Notetab *ntab, const char *name, double offset);
 void ntabfreenotes(Notetab *ntab);
 int ntabget(Notetab *ntab, const char *name, double *offset);
+Note *ntablookup(Notetab *ntab, const char *name);
 size_t ntabsize(Notetab *ntab);
 void ntabsortnames(Notetab *ntab, char *names[], size_t nnames);
 void ntabstorenames(Notetab *ntab, char *names[]);
+
+int ratioparse(Ratio *r, const char *str);
+int ratiostr(const Ratio *r, char *buf, size_t size);
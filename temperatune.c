@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "temperament.h"
+#include "temperatune.h"
+#include "util.h"
+
+struct Tt {
+	Temperament t;
+	int loaded;
+	char **names; /* in ascending order of pitch, built on first use */
+	char errbuf[256];
+};
+
+static const char *const errstrs[TTNERRORS] = {
+	"no error",
+	"out of memory",
+	"cannot read file",
+	"invalid temperament",
+	"no temperament loaded",
+	"no such note",
+	"argument out of range",
+};
+
+static int finishload(Tt *tt, int err);
+static void unload(Tt *tt);
+
+int
+ttversion(void)
+{
+	return TTVERSION;
+}
+
+const char *
+ttstrerror(int err)
+{
+	if (err < 0 || err >= TTNERRORS)
+		return "unknown error";
+	return errstrs[err];
+}
+
+/*
+ * Replaces malloc and free for the library and for jansson, whose hooks
+ * are global. It must be called before anything is allocated.
+ */
+void
+ttsetalloc(void *(*mallocfn)(size_t), void (*freefn)(void *))
+{
+	setalloc(mallocfn, freefn);
+	json_set_alloc_funcs(mallocfn, freefn);
+}
+
+int
+ttnew(Tt **tt)
+{
+	if (!(*tt = umalloc(sizeof(**tt))))
+		return TTNOMEM;
+	memset(*tt, 0, sizeof(**tt));
+	return TTOK;
+}
+
+void
+ttfree(Tt *tt)
+{
+	if (!tt)
+		return;
+	unload(tt);
+	ufree(tt);
+}
+
+/*
+ * Loads a temperament from memory, replacing any loaded before. The data
+ * is not referenced once this returns.
+ */
+int
+ttload(Tt *tt, const char *data, size_t len)
+{
+	unload(tt);
+	return finishload(tt, tparsebuf(&tt->t, data, len, TBORROW, tt->errbuf, sizeof(tt->errbuf)));
+}
+
+int
+ttloadfile(Tt *tt, const char *path)
+{
+	unload(tt);
+	return finishload(tt, tparsemap(&tt->t, path, TBORROW, tt->errbuf, sizeof(tt->errbuf)));
+}
+
+/* Returns a description of the last failed load. */
+const char *
+tterror(Tt *tt)
+{
+	return tt->errbuf;
+}
+
+const char *
+ttname(Tt *tt)
+{
+	return tt->loaded ? tt->t.name : NULL;
+}
+
+size_t
+ttnnotes(Tt *tt)
+{
+	return tt->loaded ? ntabsize(&tt->t.notes) : 0;
+}
+
+/* Gives the name of a degree, counting up in pitch from the octave base. */
+int
+ttnotename(Tt *tt, size_t degree, const char **name)
+{
+	size_t nnotes;
+
+	if (!tt->loaded)
+		return TTNOTLOADED;
+	if (degree >= (nnotes = ntabsize(&tt->t.notes)))
+		return TTRANGE;
+	if (!tt->names) {
+		if (!(tt->names = umalloc(nnotes * sizeof(*tt->names))))
+			return TTNOMEM;
+		tdegrees(&tt->t, tt->names);
+	}
+	*name = tt->names[degree];
+	return TTOK;
+}
+
+int
+ttpitch(Tt *tt, const char *note, int octave, double *freq)
+{
+	if (!tt->loaded)
+		return TTNOTLOADED;
+	if ((*freq = tgetpitch(&tt->t, note, octave)) < 0)
+		return TTNONOTE;
+	return TTOK;
+}
+
+/* Changes the reference pitch, in Hz, of the loaded temperament. */
+int
+ttsetpitch(Tt *tt, double refpitch)
+{
+	if (!tt->loaded)
+		return TTNOTLOADED;
+	if (!(refpitch > 0) || isinf(refpitch))
+		return TTRANGE;
+	tt->t.refpitch = refpitch;
+	return TTOK;
+}
+
+static int
+finishload(Tt *tt, int err)
+{
+	switch (err) {
+	case 0:
+		tt->loaded = 1;
+		tt->errbuf[0] = '\0';
+		return TTOK;
+	case TNOMEM:
+		return TTNOMEM;
+	case TNOREAD:
+		return TTNOREAD;
+	default:
+		return TTPARSE;
+	}
+}
+
+static void
+unload(Tt *tt)
+{
+	if (tt->loaded)
+		tfreefields(&tt->t);
+	ufree(tt->names);
+	tt->names = NULL;
+	tt->loaded = 0;
+}
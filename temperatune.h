@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The public interface of libtemperatune, for parsing temperaments and
+ * looking up pitches from another program. Unlike the rest of the
+ * source, this header is meant to be installed, so it has an include guard
+ * and depends on nothing but <stddef.h>. Only the functions declared here
+ * are exported from either library.
+ *
+ * Every function that can fail returns one of the error codes below
+ * rather than exiting. A Tt is not thread-safe, but separate ones may be
+ * used from separate threads.
+ */
+#ifndef TEMPERATUNE_H
+#define TEMPERATUNE_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && defined(TTBUILD)
+#define TTAPI __attribute__((visibility("default")))
+#else
+#define TTAPI
+#endif
+
+#define TTVERSION 10000 /* major * 10000 + minor * 100 + patch */
+
+enum {
+	TTOK,
+	TTNOMEM, /* out of memory */
+	TTNOREAD, /* the file could not be read */
+	TTPARSE, /* the temperament is invalid */
+	TTNOTLOADED, /* no temperament has been loaded */
+	TTNONOTE, /* the temperament has no such note */
+	TTRANGE, /* an argument is out of range */
+	TTNERRORS
+};
+
+typedef struct Tt Tt;
+
+TTAPI int ttversion(void);
+TTAPI const char *ttstrerror(int err);
+TTAPI void ttsetalloc(void *(*mallocfn)(size_t), void (*freefn)(void *));
+
+TTAPI int ttnew(Tt **tt);
+TTAPI void ttfree(Tt *tt);
+TTAPI int ttload(Tt *tt, const char *data, size_t len);
+TTAPI int ttloadfile(Tt *tt, const char *path);
+TTAPI const char *tterror(Tt *tt);
+
+TTAPI const char *ttname(Tt *tt);
+TTAPI size_t ttnnotes(Tt *tt);
+TTAPI int ttnotename(Tt *tt, size_t degree, const char **name);
+TTAPI int ttpitch(Tt *tt, const char *note, int octave, double *freq);
+TTAPI int ttsetpitch(Tt *tt, double refpitch);
+
+#endif
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A fuzzing harness for tparse, which checks each input against a naive
+ * reference resolver and against tparsebuf with borrowed strings, as well
+ * as for crashes.
+ *
+ * Built normally, this is a standalone driver that runs each file named
+ * on the command line (or standard input) through the harness, aborting
+ * if an input takes longer than the time budget (-t, in milliseconds) or
+ * if the process needs more memory than the memory budget (-m, in MiB).
+ * The standalone driver also works with AFL when built with afl-cc.
+ *
+ * Built with -DLIBFUZZER (see the fuzz target in the Makefile), the
+ * driver is left out for libFuzzer's own, which has the equivalent
+ * -timeout and -rss_limit_mb options. Either way, the files in
+ * test/print-cases make a good seed corpus.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <jansson.h>
+
+#include "temperament.h"
+#include "util.h"
+
+/*
+ * tparse treats offsets within PARSETOL of each other (relative to their
+ * size) as equal. Rounding error depends on the order in which notes are
+ * resolved, so when it could decide the outcome the harness accepts
+ * either answer.
+ */
+static const double PARSETOL = 1e-9;
+
+enum { VALID, INVALID, UNSURE };
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static int offsetcents(json_t *offset, double *cents);
+static int resolve(json_t *root, Notetab *ntab, double *tol);
+static void addratio(Notetab *ntab, const char *name, const char *from, json_t *offset, int sign);
+static double discrepancy(double a, double b);
+static void mismatch(const uint8_t *data, size_t size, const char *fmt, const char *arg);
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	FILE *input;
+	Temperament t, tb;
+	Notetab ntab;
+	json_t *root;
+	char errbuf[256];
+	double offset, want, base, tol;
+	int got, gotb, resolved, i;
+	Note *note;
+
+	if (size == 0 || !(input = fmemopen((void *)data, size, "r")))
+		return 0;
+	errbuf[0] = '\0';
+	got = tparse(&t, input, errbuf, sizeof(errbuf));
+	fclose(input);
+	gotb = tparsebuf(&tb, (const char *)data, size, TBORROW, NULL, 0);
+
+	memset(&ntab, 0, sizeof(ntab));
+	root = json_loadb((const char *)data, size, 0, NULL);
+	resolved = resolve(root, &ntab, &tol);
+
+	if (gotb != got)
+		mismatch(data, size, "tparsebuf and tparse disagree%s", "");
+	if (!got)
+		for (i = 0; i < TABSIZE; i++)
+			for (note = t.notes[i]; note; note = note->next)
+				if (ntabget(&tb.notes, note->name, &offset) || offset != note->offset)
+					mismatch(data, size, "tparsebuf gave a different offset for '%s'", note->name);
+
+	if (resolved == UNSURE) {
+		/* Nothing to compare. */
+	} else if (!got && resolved == INVALID) {
+		mismatch(data, size, "tparse accepted input that the reference resolver rejected%s", "");
+	} else if (got && resolved == VALID) {
+		mismatch(data, size, "tparse rejected valid input: %s", errbuf);
+	} else if (!got) {
+		/*
+		 * The octave base must be at or within an octave below the
+		 * reference, with every other note less than an octave above it.
+		 */
+		if (ntabget(&t.notes, t.octavebase, &base))
+			mismatch(data, size, "tparse lost the octave base '%s'", t.octavebase);
+		if (base > tol || base <= -OCTAVE_CENTS - tol)
+			mismatch(data, size, "octave base '%s' is not in the octave below the reference", t.octavebase);
+		if (ntabsize(&t.notes) != ntabsize(&ntab))
+			mismatch(data, size, "tparse found a different number of notes%s", "");
+		for (i = 0; i < TABSIZE; i++)
+			for (note = ntab[i]; note; note = note->next) {
+				want = note->offset;
+				if (ntabget(&t.notes, note->name, &offset))
+					mismatch(data, size, "tparse lost note '%s'", note->name);
+				if (discrepancy(offset, want) > tol)
+					mismatch(data, size, "tparse gave a different offset for '%s'", note->name);
+				if (offset < base - tol || offset >= base + OCTAVE_CENTS + tol)
+					mismatch(data, size, "offset of '%s' is outside the octave", note->name);
+			}
+	}
+
+	if (!got) {
+		tfreefields(&t);
+		tfreefields(&tb);
+	}
+	ntabfreenotes(&ntab);
+	json_decref(root);
+	return 0;
+}
+
+/*
+ * Resolves note offsets by repeatedly sweeping over every definition and
+ * filling in whichever side is unknown until nothing changes, then checks
+ * every definition. No intermediate value can exceed the sum of all
+ * offsets, which bounds the rounding error of any chain of definitions
+ * whatever order they are resolved in. The absolute tolerance for
+ * comparing offsets against tparse's is stored in tol. When every offset
+ * is a ratio, tparse resolves exactly, so the ratios are resolved
+ * alongside the offsets and definitions are checked on them instead.
+ */
+static int
+resolve(json_t *root, Notetab *ntab, double *tol)
+{
+	json_t *notes, *pair, *tmp;
+	const char *name, *refname, *other, *base;
+	double offset, a, b, disc, maxdisc, sum, fperr;
+	size_t ndefs;
+	int changed, hasa, hasb, exact, k;
+	Note *na, *nb;
+	Ratio r;
+
+	if (!json_is_object(root) ||
+	    !json_is_string(json_object_get(root, "name")) ||
+	    !(base = json_string_value(json_object_get(root, "octaveBaseName"))) ||
+	    !(refname = json_string_value(json_object_get(root, "referenceName"))) ||
+	    !json_is_integer(json_object_get(root, "referenceOctave")))
+		return INVALID;
+	tmp = json_object_get(root, "referencePitch");
+	if (!json_is_number(tmp) || json_number_value(tmp) <= 0)
+		return INVALID;
+	notes = json_object_get(root, "notes");
+	if (!json_is_object(notes) || json_object_size(notes) > MAXNOTES)
+		return INVALID;
+	sum = 1;
+	exact = 1;
+	json_object_foreach(notes, name, pair) {
+		if (!json_is_array(pair) || json_array_size(pair) != 2 ||
+		    !json_is_string(json_array_get(pair, 0)) ||
+		    offsetcents(json_array_get(pair, 1), &offset))
+			return INVALID;
+		sum += fabs(offset);
+		exact &= json_is_string(json_array_get(pair, 1));
+	}
+
+	ndefs = json_object_size(notes);
+	fperr = 4 * (ndefs + 1) * sum * DBL_EPSILON;
+	*tol = 2 * fperr + (ndefs + 1) * PARSETOL;
+
+	ntabadd(ntab, refname, 0);
+	do {
+		changed = 0;
+		json_object_foreach(notes, name, pair) {
+			other = json_string_value(json_array_get(pair, 0));
+			offsetcents(json_array_get(pair, 1), &offset);
+			hasa = !ntabget(ntab, name, &a);
+			hasb = !ntabget(ntab, other, &b);
+			if (hasb && !hasa) {
+				ntabadd(ntab, name, b + offset);
+				if (exact)
+					addratio(ntab, name, other, json_array_get(pair, 1), 1);
+				changed = 1;
+			} else if (hasa && !hasb) {
+				ntabadd(ntab, other, a - offset);
+				if (exact)
+					addratio(ntab, other, name, json_array_get(pair, 1), -1);
+				changed = 1;
+			}
+		}
+	} while (changed);
+
+	if (ntabget(ntab, base, NULL))
+		return INVALID;
+	maxdisc = 0;
+	json_object_foreach(notes, name, pair) {
+		other = json_string_value(json_array_get(pair, 0));
+		offsetcents(json_array_get(pair, 1), &offset);
+		if (ntabget(ntab, name, &a) || ntabget(ntab, other, &b))
+			return INVALID;
+		if (exact) {
+			/* As in tparse, ratios that differ only in octaves agree. */
+			na = ntablookup(ntab, name);
+			nb = ntablookup(ntab, other);
+			ratioparse(&r, json_string_value(json_array_get(pair, 1)));
+			for (k = 1; k < NPRIMES; k++)
+				if (na->ratio.exp[k] != nb->ratio.exp[k] + r.exp[k])
+					return INVALID;
+		}
+		if ((disc = discrepancy(a, b + offset)) > maxdisc)
+			maxdisc = disc;
+	}
+	if (exact)
+		return VALID;
+	if (maxdisc - 2 * fperr > PARSETOL * (1 + 2 * (sum + OCTAVE_CENTS)))
+		return INVALID;
+	return maxdisc + 2 * fperr < PARSETOL ? VALID : UNSURE;
+}
+
+/*
+ * Sets the ratio of a note just added to that of another note times the
+ * offset ratio, or divided by it if sign is negative.
+ */
+static void
+addratio(Notetab *ntab, const char *name, const char *from, json_t *offset, int sign)
+{
+	Note *note;
+	Ratio r;
+	int k;
+
+	note = ntablookup(ntab, name);
+	ratioparse(&r, json_string_value(offset));
+	for (k = 0; k < NPRIMES; k++)
+		note->ratio.exp[k] = ntablookup(ntab, from)->ratio.exp[k] + sign * r.exp[k];
+}
+
+/*
+ * Converts an offset, given in cents or as a ratio of integers with no
+ * prime factor above 31, to cents.
+ */
+static int
+offsetcents(json_t *offset, double *cents)
+{
+	static const unsigned int primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31 };
+	unsigned long long n[2], rest;
+	const char *s;
+	char *end;
+	size_t k;
+	int i;
+
+	if (json_is_number(offset)) {
+		*cents = json_number_value(offset);
+		return 0;
+	}
+	if (!(s = json_string_value(offset)))
+		return 1;
+	n[1] = 1;
+	for (i = 0; i < 2; i++) {
+		if (*s < '1' || *s > '9')
+			return 1;
+		errno = 0;
+		n[i] = strtoull(s, &end, 10);
+		if (errno != 0)
+			return 1;
+		for (rest = n[i], k = 0; k < sizeof(primes) / sizeof(*primes); k++)
+			while (rest % primes[k] == 0)
+				rest /= primes[k];
+		if (rest != 1)
+			return 1;
+		s = end;
+		if (*s == '\0')
+			break;
+		if (*s++ != '/' || i == 1)
+			return 1;
+	}
+	*cents = OCTAVE_CENTS * (log2(n[0]) - log2(n[1]));
+	return 0;
+}
+
+/* Returns how far apart two offsets are, ignoring octaves. */
+static double
+discrepancy(double a, double b)
+{
+	return fabs(remainder(a - b, OCTAVE_CENTS));
+}
+
+static void
+mismatch(const uint8_t *data, size_t size, const char *fmt, const char *arg)
+{
+	fprintf(stderr, "fuzz: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\ninput:\n%.*s\n", (int)size, (const char *)data);
+	abort();
+}
+
+#ifndef LIBFUZZER
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: fuzz [-m megabytes] [-t milliseconds] [input...]\n");
+	exit(2);
+}
+
+static void
+timeout(int sig)
+{
+	static const char msg[] = "fuzz: input exceeded the time budget\n";
+
+	USED(sig);
+	write(2, msg, sizeof(msg) - 1);
+	abort();
+}
+
+static void
+runfile(FILE *input, long budget)
+{
+	struct itimerval timer;
+	uint8_t *data;
+	size_t size, cap, n;
+
+	cap = 4096;
+	size = 0;
+	data = xmalloc(cap);
+	while ((n = fread(data + size, 1, cap - size, input)) > 0)
+		if ((size += n) == cap) {
+			cap *= 2;
+			if (!(data = realloc(data, cap)))
+				die("realloc: out of memory");
+		}
+
+	memset(&timer, 0, sizeof(timer));
+	timer.it_value.tv_sec = budget / 1000;
+	timer.it_value.tv_usec = budget % 1000 * 1000;
+	setitimer(ITIMER_REAL, &timer, NULL);
+	LLVMFuzzerTestOneInput(data, size);
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_REAL, &timer, NULL);
+
+	free(data);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct rlimit rl;
+	FILE *input;
+	long budget, megs;
+	char *end;
+	int opt;
+
+	budget = 1000;
+	megs = 0;
+	while ((opt = getopt(argc, argv, "m:t:")) != -1)
+		switch (opt) {
+		case 'm':
+			megs = strtol(optarg, &end, 10);
+			if (*end != '\0' || megs <= 0)
+				usage();
+			break;
+		case 't':
+			budget = strtol(optarg, &end, 10);
+			if (*end != '\0' || budget <= 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+
+	if (megs > 0) {
+		rl.rlim_cur = rl.rlim_max = (rlim_t)megs << 20;
+		if (setrlimit(RLIMIT_AS, &rl))
+			die("could not set memory budget");
+	}
+	signal(SIGALRM, timeout);
+
+	if (optind == argc) {
+		runfile(stdin, budget);
+		return 0;
+	}
+	for (; optind < argc; optind++) {
+		if (!(input = fopen(argv[optind], "r")))
+			die("could not open '%s'", argv[optind]);
+		runfile(input, budget);
+		fclose(input);
+	}
+	return 0;
+}
+
+#endif
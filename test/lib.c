@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks libtemperatune through its public interface alone: that each
+ * temperament named on the command line loads the same from a file and
+ * from memory, that lookups fail with the right error codes, and that
+ * running out of memory at any allocation fails cleanly without leaking.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "temperatune.h"
+
+static long allocsleft = -1; /* allocations before failing, or -1 for no limit */
+static int failed; /* whether the limit was reached */
+static long live;
+
+static int check(const char *path);
+static int checkoom(const char *data, size_t len, int want);
+static void *limitmalloc(size_t sz);
+static void limitfree(void *p);
+static char *readfile(const char *path, size_t *len);
+
+int
+main(int argc, char *argv[])
+{
+	Tt *tt;
+	double freq;
+	int i, err, retval;
+
+	ttsetalloc(limitmalloc, limitfree);
+	retval = 0;
+	if (ttversion() != TTVERSION || strcmp(ttstrerror(TTNONOTE), "no such note") ||
+	    strcmp(ttstrerror(-1), "unknown error")) {
+		fprintf(stderr, "bad version or error strings\n");
+		retval = 1;
+	}
+
+	if ((err = ttnew(&tt)) != TTOK) {
+		fprintf(stderr, "ttnew: %s\n", ttstrerror(err));
+		return 1;
+	}
+	if (ttpitch(tt, "A", 4, &freq) != TTNOTLOADED || ttnnotes(tt) != 0 || ttname(tt)) {
+		fprintf(stderr, "empty handle gave results\n");
+		retval = 1;
+	}
+	if (ttloadfile(tt, "no such file") != TTNOREAD || !*tterror(tt)) {
+		fprintf(stderr, "missing file not reported\n");
+		retval = 1;
+	}
+	ttfree(tt);
+
+	for (i = 1; i < argc; i++)
+		retval |= check(argv[i]);
+	if (live != 0) {
+		fprintf(stderr, "%ld allocations leaked\n", live);
+		retval = 1;
+	}
+	return retval;
+}
+
+static int
+check(const char *path)
+{
+	Tt *fromfile, *frommem;
+	const char *name, *other;
+	char *data;
+	double freq, want;
+	size_t len, deg, nnotes;
+	int err, retval;
+
+	retval = 0;
+	data = readfile(path, &len);
+	ttnew(&fromfile);
+	ttnew(&frommem);
+	err = ttloadfile(fromfile, path);
+	if (ttload(frommem, data, len) != err) {
+		fprintf(stderr, "%s: loading from a file and from memory disagree\n", path);
+		retval = 1;
+		goto DONE;
+	}
+	if (err != TTOK) {
+		if (err != TTPARSE || !*tterror(fromfile) || strcmp(tterror(fromfile), tterror(frommem))) {
+			fprintf(stderr, "%s: %s: %s\n", path, ttstrerror(err), tterror(fromfile));
+			retval = 1;
+		}
+		goto DONE;
+	}
+
+	nnotes = ttnnotes(fromfile);
+	if (nnotes != ttnnotes(frommem) || strcmp(ttname(fromfile), ttname(frommem)))
+		retval = 1;
+	for (deg = 0; deg < nnotes && !retval; deg++) {
+		if (ttnotename(fromfile, deg, &name) || ttnotename(frommem, deg, &other) ||
+		    strcmp(name, other) ||
+		    ttpitch(fromfile, name, 4, &want) || ttpitch(frommem, name, 4, &freq) || freq != want)
+			retval = 1;
+	}
+	/* Doubling the reference pitch doubles every pitch exactly. */
+	for (deg = 0; deg < nnotes && !retval; deg++) {
+		ttnotename(frommem, deg, &name);
+		if (ttsetpitch(frommem, 440) || ttpitch(frommem, name, 4, &want) ||
+		    ttsetpitch(frommem, 880) || ttpitch(frommem, name, 4, &freq) || freq != 2 * want)
+			retval = 1;
+	}
+	if (retval)
+		fprintf(stderr, "%s: notes disagree\n", path);
+	if (ttnotename(fromfile, nnotes, &name) != TTRANGE || ttpitch(fromfile, "no such note", 4, &freq) != TTNONOTE ||
+	    ttsetpitch(fromfile, 0) != TTRANGE || ttsetpitch(fromfile, -440) != TTRANGE) {
+		fprintf(stderr, "%s: bad lookups not reported\n", path);
+		retval = 1;
+	}
+
+DONE:
+	ttfree(fromfile);
+	ttfree(frommem);
+	if (!retval)
+		retval = checkoom(data, len, err);
+	free(data);
+	return retval;
+}
+
+/*
+ * Fails each allocation of loading and looking up every name in turn.
+ * jansson does not report running out of memory as such, so failures
+ * while parsing the document may read as TTPARSE.
+ */
+static int
+checkoom(const char *data, size_t len, int want)
+{
+	Tt *tt;
+	const char *name;
+	long limit;
+	size_t deg;
+	int err;
+
+	for (limit = 0;; limit++) {
+		allocsleft = limit;
+		failed = 0;
+		if ((err = ttnew(&tt)) == TTOK) {
+			err = ttload(tt, data, len);
+			for (deg = 0; err == TTOK && deg < ttnnotes(tt); deg++)
+				err = ttnotename(tt, deg, &name);
+			ttfree(tt);
+		}
+		if (live != 0) {
+			fprintf(stderr, "failing allocation %ld leaked %ld allocations\n", limit, live);
+			allocsleft = -1;
+			return 1;
+		}
+		if (!failed) {
+			allocsleft = -1;
+			if (err != want)
+				fprintf(stderr, "with enough memory, got '%s'\n", ttstrerror(err));
+			return err != want;
+		}
+		if (err != TTNOMEM && err != TTPARSE) {
+			fprintf(stderr, "failing allocation %ld gave '%s'\n", limit, ttstrerror(err));
+			allocsleft = -1;
+			return 1;
+		}
+	}
+}
+
+static void *
+limitmalloc(size_t sz)
+{
+	void *p;
+
+	if (allocsleft == 0) {
+		failed = 1;
+		return NULL;
+	}
+	if (allocsleft > 0)
+		allocsleft--;
+	if ((p = malloc(sz)))
+		live++;
+	return p;
+}
+
+static void
+limitfree(void *p)
+{
+	if (p)
+		live--;
+	free(p);
+}
+
+static char *
+readfile(const char *path, size_t *len)
+{
+	FILE *input;
+	char *data;
+	size_t cap;
+
+	if (!(input = fopen(path, "r"))) {
+		perror(path);
+		exit(1);
+	}
+	cap = 4096;
+	*len = 0;
+	if (!(data = malloc(cap)))
+		exit(1);
+	while ((*len += fread(data + *len, 1, cap - *len, input)) == cap)
+		if (!(data = realloc(data, cap *= 2)))
+			exit(1);
+	fclose(input);
+	return data;
+}
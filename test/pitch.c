@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks that a Wavebuf and a Sinebuf play every note of each temperament
+ * named on the command line in tune: each note is rendered with every
+ * waveform, and as a Sinebuf, in every octave from MINFREQ to MAXFREQ at
+ * several sample rates, and the frequency of the fundamental actually
+ * played is measured from up to a second of output. The notes are checked
+ * in parallel, but reported in order.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <portaudio.h>
+
+#include "audio.h"
+#include "pool.h"
+#include "temperament.h"
+#include "util.h"
+
+enum { LOWOCTAVE = -2, HIGHOCTAVE = 12, MAXITER = 8 };
+enum { SINEBUF = -1 }; /* in place of a waveform, to play a Sinebuf */
+
+/* Well below what anyone can hear, but well above the measurement error. */
+static const double CENTSTOL = 0.05;
+/* The weakest fundamental of any waveform, with some margin. */
+static const double MINAMP = 0.1;
+/* DFT bins kept between the fundamental and any other partial. */
+static const double SEPARATION = 25;
+static const double samprates[] = { 8000, 22050, 44100, 48000, 96000 };
+
+typedef struct Job Job;
+
+struct Job {
+	const char *path;
+	const char *note;
+	int octave;
+	int wave; /* waveform, or SINEBUF */
+	double samprate;
+	double want; /* in Hz */
+	double got; /* in Hz, or -1 if it could not be measured */
+	int rejected; /* whether wbinit or sbinit refused the frequency */
+};
+
+static void addjobs(Temperament *t, const char *path);
+static void check(void *arg, int worker, size_t i);
+static double measure(const float *restrict buf, size_t n, double samprate, double freq);
+static const char *voicename(int wave);
+
+static Job *jobs;
+static size_t njobs, cap;
+static float **bufs; /* one second of output for each worker */
+
+int
+main(int argc, char *argv[])
+{
+	Temperament *ts;
+	FILE *input;
+	char errbuf[256];
+	long l;
+	size_t i;
+	double cents;
+	int nthreads, n, retval;
+
+	if ((l = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		l = 1;
+	else if (l > 64)
+		l = 64;
+	nthreads = l;
+	ts = xcalloc(argc, sizeof(*ts));
+	for (n = 1; n < argc; n++) {
+		if (!(input = fopen(argv[n], "r")))
+			die("could not open '%s'", argv[n]);
+		if (tparse(&ts[n], input, errbuf, sizeof(errbuf)))
+			die("%s: %s", argv[n], errbuf);
+		fclose(input);
+		addjobs(&ts[n], argv[n]);
+	}
+
+	bufs = xcalloc(nthreads, sizeof(*bufs));
+	for (n = 0; n < nthreads; n++)
+		bufs[n] = xmalloc(samprates[sizeof(samprates) / sizeof(*samprates) - 1] * sizeof(**bufs));
+	poolrun(nthreads, njobs, check, NULL);
+
+	retval = 0;
+	for (i = 0; i < njobs; i++) {
+		if (jobs[i].rejected != (jobs[i].want >= jobs[i].samprate / 2)) {
+			printf("FAIL: %s: %s%d (%.2lf Hz) %s %s at %.0lf Hz\n", jobs[i].path, jobs[i].note, jobs[i].octave,
+			    jobs[i].want, voicename(jobs[i].wave), jobs[i].rejected ? "rejected" : "accepted", jobs[i].samprate);
+			retval = 1;
+			continue;
+		}
+		if (jobs[i].rejected)
+			continue;
+		cents = jobs[i].got > 0 ? OCTAVE_CENTS * log2(jobs[i].got / jobs[i].want) : HUGE_VAL;
+		if (fabs(cents) > CENTSTOL) {
+			printf("FAIL: %s: %s%d (%.2lf Hz) %s plays %.4lf Hz at %.0lf Hz (%+.3lf cents)\n", jobs[i].path,
+			    jobs[i].note, jobs[i].octave, jobs[i].want, voicename(jobs[i].wave), jobs[i].got, jobs[i].samprate,
+			    cents);
+			retval = 1;
+		}
+	}
+
+	for (n = 0; n < nthreads; n++)
+		free(bufs[n]);
+	free(bufs);
+	free(jobs);
+	for (n = 1; n < argc; n++)
+		tfreefields(&ts[n]);
+	free(ts);
+	return retval;
+}
+
+/* Adds a job for every note, octave, sample rate and waveform in range. */
+static void
+addjobs(Temperament *t, const char *path)
+{
+	Note *note;
+	double freq;
+	size_t r;
+	int b, oct, wave;
+
+	for (b = 0; b < TABSIZE; b++)
+		for (note = t->notes[b]; note; note = note->next)
+			for (oct = LOWOCTAVE; oct <= HIGHOCTAVE; oct++) {
+				freq = tgetpitch(t, note->name, oct);
+				if (freq < MINFREQ || freq > MAXFREQ)
+					continue;
+				for (r = 0; r < sizeof(samprates) / sizeof(*samprates); r++)
+					for (wave = SINEBUF; wave < NWAVES; wave++) {
+						if (njobs == cap) {
+							cap = cap ? 2 * cap : 256;
+							if (!(jobs = realloc(jobs, cap * sizeof(*jobs))))
+								die("realloc: out of memory");
+						}
+						memset(&jobs[njobs], 0, sizeof(*jobs));
+						jobs[njobs].path = path;
+						jobs[njobs].note = note->name;
+						jobs[njobs].octave = oct;
+						jobs[njobs].wave = wave;
+						jobs[njobs].samprate = samprates[r];
+						jobs[njobs++].want = freq;
+					}
+			}
+}
+
+static void
+check(void *arg, int worker, size_t i)
+{
+	Wavebuf wb;
+	Sinebuf sb;
+	Job *job;
+	size_t n;
+	int err;
+
+	USED(arg);
+	job = &jobs[i];
+	if (job->wave == SINEBUF)
+		err = sbinit(&sb, job->want, job->samprate, 1);
+	else
+		err = wbinit(&wb, job->wave, job->want, job->samprate, 1);
+	if (err) {
+		job->rejected = 1;
+		return;
+	}
+	/*
+	 * The nearest other partials are the second harmonic and the image of
+	 * the fundamental about the Nyquist frequency. Up to a second of
+	 * output fits in the buffer.
+	 */
+	n = (size_t)ceil(SEPARATION * job->samprate / fmin(job->want, job->samprate - 2 * job->want));
+	if (n > (size_t)job->samprate)
+		n = (size_t)job->samprate;
+	if (job->wave == SINEBUF) {
+		sbfill(&sb, bufs[worker], n);
+		sbfree(&sb);
+	} else {
+		wbfill(&wb, bufs[worker], n);
+	}
+	job->got = measure(bufs[worker], n, job->samprate, job->want);
+}
+
+/*
+ * Returns the frequency of the fundamental, starting from the frequency
+ * it should have, or -1 if there is too little of it. Against a phasor at
+ * the estimate, the fundamental turns at the error in the estimate, which
+ * is found from how the phase of the Hann-windowed output changes along
+ * the buffer; the corrected estimate is checked again until it settles.
+ * The window keeps other partials, at least SEPARATION bins away, from
+ * disturbing the phase.
+ */
+static double
+measure(const float *restrict buf, size_t n, double samprate, double freq)
+{
+	double w, mid, h, x, t, re;
+	double cre, cim, hre, him, pre, pim, rre, rim;
+	double sw, stt, s0re, s0im, s1re, s1im, d;
+	size_t i;
+	int iter;
+
+	mid = (n - 1) / 2.0;
+	cre = cos(2 * M_PI / (n - 1));
+	cim = sin(2 * M_PI / (n - 1));
+	for (iter = 0; iter < MAXITER; iter++) {
+		/* Both cosines are rotated sample by sample rather than computed. */
+		w = 2 * M_PI * freq / samprate;
+		rre = cos(w);
+		rim = -sin(w);
+		hre = pre = 1;
+		him = pim = 0;
+		sw = stt = s0re = s0im = s1re = s1im = 0;
+		for (i = 0; i < n; i++) {
+			h = 0.5 - 0.5 * hre;
+			t = i - mid;
+			x = h * buf[i];
+			sw += h;
+			stt += h * t * t;
+			s0re += x * pre;
+			s0im += x * pim;
+			s1re += x * t * pre;
+			s1im += x * t * pim;
+
+			re = hre * cre - him * cim;
+			him = hre * cim + him * cre;
+			hre = re;
+			re = pre * rre - pim * rim;
+			pim = pre * rim + pim * rre;
+			pre = re;
+		}
+		if (2 * hypot(s0re, s0im) / sw < MINAMP)
+			return -1;
+		/* The imaginary part of s1 / s0 is the drift times stt / sw. */
+		d = (s1im * s0re - s1re * s0im) / (s0re * s0re + s0im * s0im) * sw / stt;
+		freq += d * samprate / (2 * M_PI);
+		if (fabs(d) < 1e-9 * w)
+			break;
+	}
+	return freq;
+}
+
+static const char *
+voicename(int wave)
+{
+	return wave == SINEBUF ? "Sinebuf" : wavenames[wave];
+}
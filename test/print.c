@@ -15,6 +15,7 @@
  */
 
 #include <errno.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -31,19 +32,49 @@ main(int argc, char *argv[])
 	FILE *input;
 	Temperament t;
 	char errbuf[256];
+	int c, flags, map, dump, err;
 
-	if (argc != 2)
+	flags = map = dump = 0;
+	while ((c = getopt(argc, argv, "bdm")) != -1)
+		switch (c) {
+		case 'b':
+			flags |= TBORROW;
+			map = 1;
+			break;
+		case 'd':
+			dump = 1;
+			break;
+		case 'm':
+			map = 1;
+			break;
+		default:
+			usage();
+		}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
 		usage();
 
-	if (!(input = fopen(argv[1], "r"))) {
-		perror("temperatune: cannot open temperament file");
-		return 1;
+	if (map) {
+		err = tparsemap(&t, argv[0], flags, errbuf, sizeof(errbuf));
+	} else {
+		if (!(input = fopen(argv[0], "r"))) {
+			perror("temperatune: cannot open temperament file");
+			return 1;
+		}
+		err = tparse(&t, input, errbuf, sizeof(errbuf));
 	}
-	if (tparse(&t, input, errbuf, sizeof(errbuf))) {
+	if (err) {
 		fprintf(stderr, "temperatune: %s\n", errbuf);
 		return 1;
 	}
 
+	if (dump) {
+		err = tdump(&t, stdout);
+		tfreefields(&t);
+		return err;
+	}
+
 	printf("name: %s\n", t.name);
 	if (t.desc)
 		printf("description: %s\n", t.desc);
@@ -64,7 +95,7 @@ main(int argc, char *argv[])
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: temperatune INPUT\n");
+	fprintf(stderr, "usage: temperatune [-bdm] INPUT\n");
 	exit(2);
 }
 
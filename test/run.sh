@@ -1,15 +1,211 @@
 #!/bin/sh
 retval=0
 
-for input in print-cases/*.in; do
+# Parsing from a stream, a mapped file and borrowed strings must agree.
+for flags in "" -m -b; do
+	for input in print-cases/*.in; do
+		outfile=$(mktemp temperatune.XXXXXX)
+		case=$(basename "$input" .in)
+		./print $flags "$input" >"$outfile" 2>&1
+		if ! diff "print-cases/$case.out" "$outfile"; then
+			echo "FAIL: $case $flags"
+			retval=1
+		fi
+		rm "$outfile"
+	done
+done
+
+for output in beats-cases/*.out; do
 	outfile=$(mktemp temperatune.XXXXXX)
+	case=$(basename "$output" .out)
+	../ttbeats "print-cases/$case.in" >"$outfile" 2>&1
+	if ! diff "$output" "$outfile"; then
+		echo "FAIL: beats $case"
+		retval=1
+	fi
+	rm "$outfile"
+done
+
+# Results are reported in input order however many threads check them.
+for j in 1 4; do
+	outfile=$(mktemp temperatune.XXXXXX)
+	../ttcheck -j "$j" print-cases/*.in >"$outfile" 2>/dev/null
+	if ! diff check-cases/print-cases.out "$outfile"; then
+		echo "FAIL: check -j $j"
+		retval=1
+	fi
+	rm "$outfile"
+done
+
+# A symbolic link loop must not be followed.
+loopdir=$(mktemp -d temperatune.XXXXXX)
+cp print-cases/qcm.json.in "$loopdir/qcm.json"
+ln -s .. "$loopdir/loop"
+if ! ../ttcheck "$loopdir" 2>/dev/null | grep -q '"file":"'"$loopdir"'/qcm.json"' ||
+    [ "$(../ttcheck "$loopdir" 2>/dev/null | wc -l)" -ne 1 ]; then
+	echo "FAIL: check symlink loop"
+	retval=1
+fi
+rm -r "$loopdir"
+
+# Dumping a temperament and parsing it again must give back the same notes.
+dumpdir=$(mktemp -d temperatune.XXXXXX)
+for input in print-cases/*.in; do
 	case=$(basename "$input" .in)
-	./print "$input" >"$outfile" 2>&1
-	if ! diff "print-cases/$case.out" "$outfile"; then
-		echo "FAIL: $case"
+	if ./print -d "$input" >"$dumpdir/dump" 2>/dev/null; then
+		./print "$dumpdir/dump" >"$dumpdir/got" 2>&1
+		if ! diff "print-cases/$case.out" "$dumpdir/got"; then
+			echo "FAIL: dump round trip $case"
+			retval=1
+		fi
+	fi
+done
+rm -r "$dumpdir"
+
+# The optimizer must give the same result for a seed however many threads it uses.
+for targets in opt-cases/*.txt; do
+	out1=$(mktemp temperatune.XXXXXX)
+	out4=$(mktemp temperatune.XXXXXX)
+	case=$(basename "$targets" .txt)
+	../ttopt -c 8 -i 2000 -j 1 -s 1 print-cases/equal.json.in "$targets" >"$out1" 2>&1
+	../ttopt -c 8 -i 2000 -j 4 -s 1 print-cases/equal.json.in "$targets" >"$out4" 2>&1
+	if ! diff "$out1" "$out4" || ! ./print "$out1" >/dev/null; then
+		echo "FAIL: opt $case"
+		retval=1
+	fi
+	rm "$out1" "$out4"
+done
+
+scaladir=$(mktemp -d temperatune.XXXXXX)
+for input in scala-cases/*.scl; do
+	outfile=$(mktemp temperatune.XXXXXX)
+	case=$(basename "$input" .scl)
+	kbm=
+	if [ -f "scala-cases/$case.kbm" ]; then
+		kbm="-k scala-cases/$case.kbm"
+	fi
+	if ../ttscala $kbm -o "$scaladir" "$input" >"$outfile" 2>/dev/null; then
+		./print "$scaladir/$case.json" >"$outfile" 2>&1
+	fi
+	if ! diff "scala-cases/$case.out" "$outfile"; then
+		echo "FAIL: scala $case"
 		retval=1
 	fi
 	rm "$outfile"
 done
 
+# Scales of the same name in different directories must not share an output.
+mkdir "$scaladir/a" "$scaladir/b"
+cp scala-cases/werck3.scl "$scaladir/a/s.scl"
+cp scala-cases/werck3.scl "$scaladir/b/s.scl"
+if ../ttscala -o "$scaladir" "$scaladir/a" "$scaladir/b" >"$scaladir/got" 2>/dev/null ||
+    ! grep -q "^$scaladir/b/s.scl: output would overwrite that of $scaladir/a/s.scl\$" "$scaladir/got" ||
+    ! ./print "$scaladir/s.json" >/dev/null; then
+	echo "FAIL: scala output clash"
+	retval=1
+fi
+rm -r "$scaladir/a" "$scaladir/b"
+
+# Exporting to Scala and importing again must give back the same notes.
+for input in print-cases/equal.json.in print-cases/qcm.json.in; do
+	case=$(basename "$input" .in)
+	../ttscala -x -o "$scaladir" "$input" 2>/dev/null
+	../ttscala -k "$scaladir/$case.kbm" -o "$scaladir" "$scaladir/$case.scl" 2>/dev/null
+	./print "$scaladir/$case.json" | sed -n '/^octave base/,$p' >"$scaladir/got"
+	sed -n '/^octave base/,$p' "print-cases/$case.out" >"$scaladir/want"
+	if ! diff "$scaladir/want" "$scaladir/got"; then
+		echo "FAIL: scala round trip $case"
+		retval=1
+	fi
+done
+
+# Exact temperaments must keep their ratios, whatever the notes are called.
+../ttscala -x -o "$scaladir" print-cases/ji.json.in 2>/dev/null
+../ttscala -k "$scaladir/ji.json.kbm" -o "$scaladir" "$scaladir/ji.json.scl" 2>/dev/null
+./print -d print-cases/ji.json.in | grep -o '"[0-9]*/[0-9]*"' | sort >"$scaladir/want"
+./print -d "$scaladir/ji.json.json" | grep -o '"[0-9]*/[0-9]*"' | sort >"$scaladir/got"
+if ! diff "$scaladir/want" "$scaladir/got"; then
+	echo "FAIL: scala round trip ji.json"
+	retval=1
+fi
+rm -r "$scaladir"
+
+outfile=$(mktemp temperatune.XXXXXX)
+../ttmidi print-cases/qcm.json.in | od -An -tx1 -v >"$outfile"
+if ! diff midi-cases/qcm.syx.out "$outfile"; then
+	echo "FAIL: midi bulk dump"
+	retval=1
+fi
+../ttmidi -n print-cases/pyd.json.in | od -An -tx1 -v >"$outfile"
+if ! diff midi-cases/pyd.notes.out "$outfile"; then
+	echo "FAIL: midi single note changes"
+	retval=1
+fi
+../ttmidi -m -c print-cases/qcm.json.in C 4 E 4 G 4 | od -An -tx1 -v >"$outfile"
+if ! diff midi-cases/qcm-chord.mid.out "$outfile"; then
+	echo "FAIL: midi file"
+	retval=1
+fi
+rm "$outfile"
+
+if ! ./fuzz print-cases/*.in; then
+	echo "FAIL: fuzz seed corpus"
+	retval=1
+fi
+
+# The longest allowed reference chain, resolved in the slowest direction,
+# must stay within the fuzzer's time budget.
+chain() {
+	awk -v n="$1" 'BEGIN {
+		printf "{\"name\":\"chain\",\"octaveBaseName\":\"N0\",\"referencePitch\":440,"
+		printf "\"referenceName\":\"N%d\",\"referenceOctave\":4,\"notes\":{\"N0\":[\"N0\",0]", n - 1
+		for (i = 1; i < n; i++)
+			printf ",\"N%d\":[\"N%d\",1.5]", i, i - 1
+		printf "}}\n"
+	}'
+}
+outfile=$(mktemp temperatune.XXXXXX)
+chain 1024 >"$outfile"
+if ! ./fuzz -t 1000 -m 256 "$outfile"; then
+	echo "FAIL: fuzz long chain"
+	retval=1
+fi
+chain 1025 >"$outfile"
+if ./print "$outfile" >/dev/null 2>&1; then
+	echo "FAIL: too many notes accepted"
+	retval=1
+fi
+rm "$outfile"
+
+if ! ./view print-cases/equal.json.in print-cases/ji.json.in print-cases/pyd.json.in print-cases/qcm.json.in; then
+	echo "FAIL: view"
+	retval=1
+fi
+
+# The library must behave the same through its public interface alone.
+if ! LD_LIBRARY_PATH=..${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH} ./lib print-cases/*.in; then
+	echo "FAIL: lib"
+	retval=1
+fi
+
+# The static library must define nothing else for a program to clash with,
+# and must never exit the program.
+syms=$(nm -g ../libtemperatune.a | awk '
+	NF == 3 && $3 !~ /^tt/ { print $3 }
+	NF == 2 && $1 == "U" && $2 ~ /^(_?exit|abort)$/ { print $2 }')
+if [ -n "$syms" ]; then
+	echo "FAIL: libtemperatune.a has" $syms
+	retval=1
+fi
+
+if ! ./pitch print-cases/equal.json.in print-cases/ji.json.in print-cases/pyd.json.in print-cases/qcm.json.in; then
+	echo "FAIL: pitch"
+	retval=1
+fi
+
+if ! ./wavetable; then
+	echo "FAIL: wavetable"
+	retval=1
+fi
+
 exit $retval
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks that a view gives the same pitches as tgetpitch for every note
+ * of each temperament named on the command line, across a range of
+ * octaves and as the reference pitch changes.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "temperament.h"
+#include "view.h"
+#include "util.h"
+
+enum { LOWOCTAVE = -1, HIGHOCTAVE = 9 };
+
+static const double TOLERANCE = 1e-12;
+/* Baroque, classical, modern and orchestral pitches, then back again. */
+static const double refpitches[] = { 415, 430, 440, 442, 415 };
+
+static int checkfile(const char *path);
+
+int
+main(int argc, char *argv[])
+{
+	int i, retval;
+
+	retval = 0;
+	for (i = 1; i < argc; i++)
+		retval |= checkfile(argv[i]);
+	return retval;
+}
+
+static int
+checkfile(const char *path)
+{
+	FILE *input;
+	Temperament t;
+	Tview v;
+	Note *note;
+	const double *ratios;
+	double want, got;
+	char errbuf[256];
+	size_t i;
+	int bucket, oct, retval;
+
+	if (!(input = fopen(path, "r")))
+		die("could not open '%s'", path);
+	if (tparse(&t, input, errbuf, sizeof(errbuf)))
+		die("%s: %s", path, errbuf);
+	fclose(input);
+	if (tvinit(&v, &t, LOWOCTAVE, HIGHOCTAVE))
+		die("%s: could not make a view", path);
+
+	retval = 0;
+	ratios = NULL;
+	for (i = 0; i < sizeof(refpitches) / sizeof(*refpitches); i++) {
+		tvsetpitch(&v, refpitches[i]);
+		t.refpitch = refpitches[i];
+		for (bucket = 0; bucket < TABSIZE; bucket++)
+			for (note = t.notes[bucket]; note; note = note->next)
+				for (oct = LOWOCTAVE; oct <= HIGHOCTAVE; oct++) {
+					want = tgetpitch(&t, note->name, oct);
+					got = tvpitch(&v, note->name, oct);
+					if (fabs(got - want) > TOLERANCE * want) {
+						printf("%s: %s%d at %.0lf Hz: want %.9lf, got %.9lf\n",
+						    path, note->name, oct, refpitches[i], want, got);
+						retval = 1;
+					}
+				}
+		/* Only the reference pitch changed, so the table must not be rebuilt. */
+		if (ratios && v.ratios != ratios) {
+			printf("%s: table rebuilt for a new reference pitch\n", path);
+			retval = 1;
+		}
+		ratios = v.ratios;
+	}
+	if (!tvsetpitch(&v, 0) || !tvsetpitch(&v, -440) || !tvsetpitch(&v, INFINITY) || !tvsetpitch(&v, NAN) ||
+	    tvpitch(&v, t.refname, t.refoctave) != refpitches[i - 1]) {
+		printf("%s: bad reference pitch accepted\n", path);
+		retval = 1;
+	}
+	if (tvpitch(&v, t.refname, LOWOCTAVE - 1) != -1 || tvpitch(&v, t.refname, HIGHOCTAVE + 1) != -1 ||
+	    tvfreq(&v, v.nnotes, LOWOCTAVE) != -1) {
+		printf("%s: out of range lookup succeeded\n", path);
+		retval = 1;
+	}
+
+	tvfree(&v);
+	tfreefields(&t);
+	return retval;
+}
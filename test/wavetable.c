@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks that a Wavebuf plays only the harmonics of its pitch, for every
+ * waveform from MINFREQ to MAXFREQ at several sample rates. Each pitch is
+ * moved slightly so that it falls exactly on a bin of an NSAMP-point DFT
+ * of the output, which then shows anything inharmonic, such as partials
+ * folded back from above the Nyquist frequency or the images left by
+ * interpolating between table samples, without any leakage to hide it.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <portaudio.h>
+
+#include "audio.h"
+#include "util.h"
+
+enum { NSAMP = 1 << 14 };
+
+/* Inharmonic energy allowed, relative to the whole signal, in dB. */
+static const double MAXINHARM = -80;
+/* Pitches are checked this many semitones apart. */
+static const double STEP = 5;
+static const double samprates[] = { 8000, 22050, 44100, 48000, 96000 };
+
+static int checkpitch(int wave, double freq, double samprate, float *buf, double *re, double *im);
+static void fft(double *re, double *im, size_t n);
+
+int
+main(void)
+{
+	float *buf;
+	double *re, *im, freq;
+	size_t i;
+	int wave, retval;
+
+	buf = xmalloc(NSAMP * sizeof(*buf));
+	re = xmalloc(NSAMP * sizeof(*re));
+	im = xmalloc(NSAMP * sizeof(*im));
+	retval = 0;
+	for (wave = 0; wave < NWAVES; wave++)
+		for (i = 0; i < sizeof(samprates) / sizeof(*samprates); i++)
+			for (freq = MINFREQ; freq <= MAXFREQ; freq *= pow(2, STEP / 12))
+				retval |= checkpitch(wave, freq, samprates[i], buf, re, im);
+	free(buf);
+	free(re);
+	free(im);
+	return retval;
+}
+
+static int
+checkpitch(int wave, double freq, double samprate, float *buf, double *re, double *im)
+{
+	Wavebuf wb;
+	double harm, inharm, db;
+	size_t k, b;
+
+	/* The nearest whole number of cycles in the buffer, within range. */
+	k = (size_t)round(freq * NSAMP / samprate);
+	if (k * samprate / NSAMP < MINFREQ)
+		k++;
+	if (k * samprate / NSAMP > MAXFREQ)
+		k--;
+	freq = k * samprate / NSAMP;
+
+	if (wbinit(&wb, wave, freq, samprate, 1)) {
+		if (freq < samprate / 2) {
+			printf("FAIL: %s: cannot play %.2lf Hz at %.0lf Hz\n", wavenames[wave], freq, samprate);
+			return 1;
+		}
+		return 0;
+	}
+	if (freq >= samprate / 2) {
+		printf("FAIL: %s: plays %.2lf Hz at %.0lf Hz, above Nyquist\n", wavenames[wave], freq, samprate);
+		return 1;
+	}
+
+	wbfill(&wb, buf, NSAMP);
+	for (b = 0; b < NSAMP; b++) {
+		re[b] = buf[b];
+		im[b] = 0;
+	}
+	fft(re, im, NSAMP);
+	harm = inharm = 0;
+	for (b = 0; b <= NSAMP / 2; b++)
+		if (b % k == 0 && b != 0)
+			harm += re[b] * re[b] + im[b] * im[b];
+		else
+			inharm += re[b] * re[b] + im[b] * im[b];
+
+	db = 10 * log10(inharm / (harm + inharm));
+	if (harm == 0 || db > MAXINHARM) {
+		printf("FAIL: %s: %.2lf Hz at %.0lf Hz is %.1lf dB inharmonic\n", wavenames[wave], freq, samprate, db);
+		return 1;
+	}
+	return 0;
+}
+
+/* An in-place radix-2 FFT of NSAMP points. */
+static void
+fft(double *re, double *im, size_t n)
+{
+	static double cosines[NSAMP / 2], sines[NSAMP / 2];
+	size_t i, j, len, k, half;
+	double t, wr, wi, ur, ui, vr, vi;
+
+	if (sines[1] == 0)
+		for (k = 0; k < NSAMP / 2; k++) {
+			cosines[k] = cos(2 * M_PI * k / NSAMP);
+			sines[k] = -sin(2 * M_PI * k / NSAMP);
+		}
+
+	for (i = 1, j = 0; i < n; i++) {
+		for (k = n >> 1; j & k; k >>= 1)
+			j ^= k;
+		j |= k;
+		if (i < j) {
+			t = re[i], re[i] = re[j], re[j] = t;
+			t = im[i], im[i] = im[j], im[j] = t;
+		}
+	}
+	for (len = 2; len <= n; len <<= 1) {
+		half = len / 2;
+		for (i = 0; i < n; i += len)
+			for (k = 0; k < half; k++) {
+				wr = cosines[k * (NSAMP / len)];
+				wi = sines[k * (NSAMP / len)];
+				ur = re[i + k];
+				ui = im[i + k];
+				vr = re[i + k + half] * wr - im[i + k + half] * wi;
+				vi = re[i + k + half] * wi + im[i + k + half] * wr;
+				re[i + k] = ur + vr;
+				im[i + k] = ui + vi;
+				re[i + k + half] = ur - vr;
+				im[i + k + half] = ui - vi;
+			}
+	}
+}
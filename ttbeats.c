@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "temperament.h"
+#include "interval.h"
+#include "util.h"
+
+enum { CSV, JSON };
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: ttbeats [-f format] [-o octave] [-r reference] temperament...\n");
+	exit(2);
+}
+
+static void
+csvstr(const char *s)
+{
+	if (!strpbrk(s, ",\"\n")) {
+		fputs(s, stdout);
+		return;
+	}
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"')
+			putchar('"');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static void
+printivs(Ivtab *iv, const char *name, int octave, int format)
+{
+	size_t i, j, k;
+	const int *ratio;
+
+	for (i = 0; i < iv->nnotes; i++)
+		for (j = 0; j < iv->nnotes; j++) {
+			k = i * iv->nnotes + j;
+			ratio = justratios[iv->just[k]];
+			if (format == CSV) {
+				csvstr(name);
+				printf(",%d,", octave);
+				csvstr(iv->names[i]);
+				putchar(',');
+				csvstr(iv->names[j]);
+				printf(",%.2lf,%d/%d,%.2lf,%.3lf\n", iv->cents[k], ratio[0], ratio[1], iv->dev[k], iv->beats[k]);
+			} else {
+				printf("{\"temperament\":");
+				jsonstr(name);
+				printf(",\"octave\":%d,\"lower\":", octave);
+				jsonstr(iv->names[i]);
+				printf(",\"upper\":");
+				jsonstr(iv->names[j]);
+				printf(",\"cents\":%.2lf,\"just\":\"%d/%d\",\"deviation\":%.2lf,\"beats\":%.3lf}\n", iv->cents[k], ratio[0], ratio[1], iv->dev[k], iv->beats[k]);
+			}
+		}
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt, format, retval, hasoctave;
+	long octave;
+	double refpitch;
+	char *end, errbuf[256];
+	FILE *tfile;
+	Temperament t;
+	Ivtab iv;
+
+	format = CSV;
+	hasoctave = 0;
+	octave = 0;
+	refpitch = 0;
+	while ((opt = getopt(argc, argv, ":f:o:r:")) != -1)
+		switch (opt) {
+		case 'f':
+			if (!strcmp(optarg, "csv"))
+				format = CSV;
+			else if (!strcmp(optarg, "json"))
+				format = JSON;
+			else
+				die("bad format: '%s'", optarg);
+			break;
+		case 'o':
+			errno = 0;
+			octave = strtol(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || octave < INT_MIN || octave > INT_MAX)
+				die("bad octave: '%s'", optarg);
+			hasoctave = 1;
+			break;
+		case 'r':
+			errno = 0;
+			refpitch = strtod(optarg, &end);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || refpitch <= 0)
+				die("bad reference pitch: '%s'", optarg);
+			break;
+		case ':':
+			fprintf(stderr, "'%c' expects an argument", optopt);
+			usage();
+			break;
+		case '?':
+			fprintf(stderr, "unknown option '%c'", optopt);
+			usage();
+			break;
+		}
+
+	if (optind == argc)
+		usage();
+
+	if (format == CSV)
+		printf("temperament,octave,lower,upper,cents,just,deviation,beats\n");
+
+	retval = 0;
+	memset(&iv, 0, sizeof(iv));
+	for (; optind < argc; optind++) {
+		if (!(tfile = fopen(argv[optind], "r"))) {
+			fprintf(stderr, "temperatune: %s: %s\n", argv[optind], strerror(errno));
+			retval = 1;
+			continue;
+		}
+		if (tparse(&t, tfile, errbuf, sizeof(errbuf))) {
+			fprintf(stderr, "temperatune: %s: %s\n", argv[optind], errbuf);
+			fclose(tfile);
+			retval = 1;
+			continue;
+		}
+		fclose(tfile);
+
+		ivload(&iv, &t);
+		if (!hasoctave)
+			octave = t.refoctave;
+		ivcompute(&iv, refpitch > 0 ? refpitch : t.refpitch, octave);
+		printivs(&iv, t.name, octave, format);
+		tfreefields(&t);
+	}
+	ivfree(&iv);
+
+	return retval;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "temperament.h"
+#include "pool.h"
+#include "util.h"
+#include "walk.h"
+
+typedef struct Arena Arena;
+typedef struct Check Check;
+typedef struct Job Job;
+
+struct Job {
+	char *path;
+	char *name;
+	size_t nnotes;
+	int failed;
+	char errbuf[256];
+};
+
+/* Each worker reads every file into the same buffer, grown as needed. */
+struct Arena {
+	char *buf;
+	size_t cap;
+};
+
+struct Check {
+	Job *jobs;
+	size_t njobs;
+	size_t cap;
+	Arena *arenas;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: ttcheck [-j threads] temperament...\n");
+	exit(2);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+addjob(void *arg, const char *path)
+{
+	Check *c;
+
+	c = arg;
+	if (c->njobs == c->cap) {
+		c->cap = c->cap ? 2 * c->cap : 64;
+		if (!(c->jobs = realloc(c->jobs, c->cap * sizeof(*c->jobs))))
+			die("realloc: out of memory");
+	}
+	memset(&c->jobs[c->njobs], 0, sizeof(*c->jobs));
+	c->jobs[c->njobs++].path = xstrdup(path);
+}
+
+/* Reads a whole file into the arena, returning its length. */
+static int
+readfile(Arena *a, const char *path, size_t *len, char *errbuf, size_t errsize)
+{
+	FILE *input;
+
+	if (!(input = fopen(path, "r"))) {
+		snprintf(errbuf, errsize, "%s", strerror(errno));
+		return 1;
+	}
+	*len = 0;
+	for (;;) {
+		if (*len == a->cap) {
+			a->cap = a->cap ? 2 * a->cap : 65536;
+			if (!(a->buf = realloc(a->buf, a->cap)))
+				die("realloc: out of memory");
+		}
+		*len += fread(a->buf + *len, 1, a->cap - *len, input);
+		if (*len < a->cap)
+			break;
+	}
+	if (ferror(input)) {
+		snprintf(errbuf, errsize, "%s", strerror(errno));
+		fclose(input);
+		return 1;
+	}
+	fclose(input);
+	return 0;
+}
+
+static void
+check(void *arg, int worker, size_t i)
+{
+	Check *c;
+	Job *job;
+	Temperament t;
+	size_t len;
+
+	c = arg;
+	job = &c->jobs[i];
+	if (readfile(&c->arenas[worker], job->path, &len, job->errbuf, sizeof(job->errbuf)) ||
+	    tparsebuf(&t, c->arenas[worker].buf, len, TBORROW, job->errbuf, sizeof(job->errbuf))) {
+		job->failed = 1;
+		return;
+	}
+	job->name = xstrdup(t.name);
+	job->nnotes = ntabsize(&t.notes);
+	tfreefields(&t);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt, nthreads, n;
+	long l;
+	size_t i, nfailed;
+	double elapsed;
+	char *end;
+	Check c;
+
+	memset(&c, 0, sizeof(c));
+	if ((l = sysconf(_SC_NPROCESSORS_ONLN)) < 1 || l > INT_MAX)
+		l = 1;
+	nthreads = l;
+	while ((opt = getopt(argc, argv, ":j:")) != -1)
+		switch (opt) {
+		case 'j':
+			errno = 0;
+			l = strtol(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || l < 1 || l > INT_MAX)
+				die("bad thread count: '%s'", optarg);
+			nthreads = l;
+			break;
+		case ':':
+			fprintf(stderr, "'%c' expects an argument", optopt);
+			usage();
+			break;
+		case '?':
+			fprintf(stderr, "unknown option '%c'", optopt);
+			usage();
+			break;
+		}
+
+	if (optind == argc)
+		usage();
+	elapsed = now();
+	for (; optind < argc; optind++)
+		walk(argv[optind], ".json", addjob, &c);
+
+	c.arenas = xcalloc(nthreads, sizeof(*c.arenas));
+	poolrun(nthreads, c.njobs, check, &c);
+	elapsed = now() - elapsed;
+	for (n = 0; n < nthreads; n++)
+		free(c.arenas[n].buf);
+	free(c.arenas);
+
+	nfailed = 0;
+	for (i = 0; i < c.njobs; i++) {
+		printf("{\"file\":");
+		jsonstr(c.jobs[i].path);
+		if (c.jobs[i].failed) {
+			printf(",\"error\":");
+			jsonstr(c.jobs[i].errbuf);
+			nfailed++;
+		} else {
+			printf(",\"name\":");
+			jsonstr(c.jobs[i].name);
+			printf(",\"notes\":%zu", c.jobs[i].nnotes);
+		}
+		printf("}\n");
+		free(c.jobs[i].path);
+		free(c.jobs[i].name);
+	}
+	free(c.jobs);
+	fprintf(stderr, "ttcheck: %zu of %zu files valid in %.3lf s (%.0lf files/s)\n",
+	    c.njobs - nfailed, c.njobs, elapsed, elapsed > 0 ? c.njobs / elapsed : 0);
+	return nfailed ? 1 : 0;
+}
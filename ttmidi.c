@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "temperament.h"
+#include "midi.h"
+#include "util.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: ttmidi [-c] [-m] [-n] [-o output] [-p program] [-r reference] temperament [note octave ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt, chord, smf, single, prog, *keys, key;
+	long l;
+	double refpitch;
+	char *end, *outpath, errbuf[256];
+	unsigned char msg[MTSBULKSIZE];
+	size_t nkeys, i, len;
+	FILE *file;
+	Temperament t;
+	Keytab kt;
+
+	chord = smf = single = 0;
+	prog = 0;
+	refpitch = 0;
+	outpath = NULL;
+	while ((opt = getopt(argc, argv, ":cmno:p:r:")) != -1)
+		switch (opt) {
+		case 'c':
+			chord = 1;
+			break;
+		case 'm':
+			smf = 1;
+			break;
+		case 'n':
+			single = 1;
+			break;
+		case 'o':
+			outpath = optarg;
+			break;
+		case 'p':
+			errno = 0;
+			l = strtol(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || l < 0 || l > 127)
+				die("bad tuning program: '%s'", optarg);
+			prog = l;
+			break;
+		case 'r':
+			errno = 0;
+			refpitch = strtod(optarg, &end);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || refpitch <= 0)
+				die("bad reference pitch: '%s'", optarg);
+			break;
+		case ':':
+			fprintf(stderr, "'%c' expects an argument", optopt);
+			usage();
+			break;
+		case '?':
+			fprintf(stderr, "unknown option '%c'", optopt);
+			usage();
+			break;
+		}
+
+	if (optind == argc || (argc - optind - 1) % 2 != 0)
+		usage();
+	if (!smf && (chord || argc - optind > 1))
+		usage();
+
+	if (!(file = fopen(argv[optind], "r")))
+		die("could not open temperament file");
+	if (tparse(&t, file, errbuf, sizeof(errbuf)))
+		die("%s", errbuf);
+	fclose(file);
+	if (ktinit(&kt, &t, refpitch > 0 ? refpitch : t.refpitch))
+		die("temperament has no notes");
+
+	nkeys = (argc - optind - 1) / 2;
+	keys = xcalloc(nkeys ? nkeys : 1, sizeof(*keys));
+	for (i = 0; i < nkeys; i++) {
+		errno = 0;
+		l = strtol(argv[optind + 2 + 2 * i], &end, 10);
+		if (errno != 0 || *end != '\0' || *argv[optind + 2 + 2 * i] == '\0' || l < INT_MIN || l > INT_MAX)
+			die("bad octave: '%s'", argv[optind + 2 + 2 * i]);
+		if ((key = ktkey(&kt, argv[optind + 1 + 2 * i], l)) < 0)
+			die("no key for note: '%s' %ld", argv[optind + 1 + 2 * i], l);
+		keys[i] = key;
+	}
+
+	/*
+	 * Raw MIDI device nodes are written just like files, so output can go
+	 * straight to a synthesizer.
+	 */
+	if (!outpath)
+		file = stdout;
+	else if (!(file = fopen(outpath, "wb")))
+		die("could not open '%s'", outpath);
+
+	if (smf) {
+		if (smfwrite(&kt, keys, nkeys, chord, file))
+			die("could not write MIDI file");
+	} else if (single) {
+		for (key = 0; key < NKEYS; key += NKEYS / 2) {
+			len = mtsnotes(&kt, prog, key, NKEYS / 2, msg);
+			fwrite(msg, 1, len, file);
+		}
+	} else {
+		len = mtsbulk(&kt, prog, t.name, msg);
+		fwrite(msg, 1, len, file);
+	}
+	if (fflush(file) || ferror(file))
+		die("could not write output");
+	if (outpath)
+		fclose(file);
+
+	free(keys);
+	ktfree(&kt);
+	tfreefields(&t);
+	return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "temperament.h"
+#include "optimize.h"
+#include "util.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: ttopt [-c chains] [-i iterations] [-j threads] [-n name] [-s seed] [-v] template targets\n");
+	exit(2);
+}
+
+static size_t
+findnote(char *names[], size_t nnames, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < nnames; i++)
+		if (!strcmp(names[i], name))
+			return i;
+	return nnames;
+}
+
+/*
+ * Parses a size given either as a ratio ("5/4") or in cents ("386.3")
+ * into cents within (0, OCTAVE_CENTS], returning a negative number on
+ * error.
+ */
+static double
+parsesize(const char *s)
+{
+	double num, den, size;
+	char *end;
+
+	errno = 0;
+	num = strtod(s, &end);
+	if (errno != 0 || end == s)
+		return -1;
+	if (*end == '\0') {
+		size = num;
+	} else if (*end == '/') {
+		s = end + 1;
+		den = strtod(s, &end);
+		if (errno != 0 || end == s || *end != '\0' || num <= 0 || den <= 0)
+			return -1;
+		size = OCTAVE_CENTS * log2(num / den);
+	} else {
+		return -1;
+	}
+	if (size <= 0 || size > OCTAVE_CENTS)
+		return -1;
+	return size;
+}
+
+/*
+ * Reads targets, one per line, as a lower note, an upper note, a size and
+ * an optional weight (default 1). Blank lines and anything after a '#'
+ * are ignored.
+ */
+static Target *
+readtargets(FILE *input, char *names[], size_t nnames, size_t *ntargets)
+{
+	Target *targets, *tg;
+	size_t cap, lineno;
+	char line[1024], *fields[4], *end;
+	int nfields;
+
+	cap = 16;
+	targets = xmalloc(cap * sizeof(*targets));
+	*ntargets = 0;
+	lineno = 0;
+	while (fgets(line, sizeof(line), input)) {
+		lineno++;
+		line[strcspn(line, "#\n")] = '\0';
+		nfields = 0;
+		for (fields[0] = strtok(line, " \t"); fields[nfields]; fields[nfields] = strtok(NULL, " \t"))
+			if (++nfields == 4)
+				break;
+		if (nfields == 0)
+			continue;
+		if (nfields < 3)
+			die("targets line %zu: expected lower note, upper note and size", lineno);
+
+		if (*ntargets == cap) {
+			cap *= 2;
+			if (!(targets = realloc(targets, cap * sizeof(*targets))))
+				die("realloc: out of memory");
+		}
+		tg = &targets[(*ntargets)++];
+		if ((tg->lower = findnote(names, nnames, fields[0])) == nnames)
+			die("targets line %zu: unknown note '%s'", lineno, fields[0]);
+		if ((tg->upper = findnote(names, nnames, fields[1])) == nnames)
+			die("targets line %zu: unknown note '%s'", lineno, fields[1]);
+		if ((tg->cents = parsesize(fields[2])) < 0)
+			die("targets line %zu: bad size '%s'", lineno, fields[2]);
+		tg->weight = 1;
+		if (nfields == 4) {
+			errno = 0;
+			tg->weight = strtod(fields[3], &end);
+			if (errno != 0 || *end != '\0' || tg->weight < 0)
+				die("targets line %zu: bad weight '%s'", lineno, fields[3]);
+		}
+	}
+	if (ferror(input))
+		die("could not read targets");
+	return targets;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt, verbose;
+	long l;
+	unsigned long ul;
+	char *end, *name, **names, desc[256], errbuf[256];
+	FILE *file;
+	Temperament t;
+	Optimizer o;
+	Target *targets;
+	size_t nnames, i;
+	double *start, elapsed;
+
+	memset(&o, 0, sizeof(o));
+	o.nchains = 64;
+	o.niters = 20000;
+	if ((l = sysconf(_SC_NPROCESSORS_ONLN)) < 1 || l > INT_MAX)
+		l = 1;
+	o.nthreads = l;
+	name = NULL;
+	verbose = 0;
+	while ((opt = getopt(argc, argv, ":c:i:j:n:s:v")) != -1)
+		switch (opt) {
+		case 'c':
+			errno = 0;
+			ul = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || ul == 0)
+				die("bad chain count: '%s'", optarg);
+			o.nchains = ul;
+			break;
+		case 'i':
+			errno = 0;
+			ul = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0')
+				die("bad iteration count: '%s'", optarg);
+			o.niters = ul;
+			break;
+		case 'j':
+			errno = 0;
+			l = strtol(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || l < 1 || l > INT_MAX)
+				die("bad thread count: '%s'", optarg);
+			o.nthreads = l;
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		case 's':
+			errno = 0;
+			o.seed = strtoull(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0')
+				die("bad seed: '%s'", optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case ':':
+			fprintf(stderr, "'%c' expects an argument", optopt);
+			usage();
+			break;
+		case '?':
+			fprintf(stderr, "unknown option '%c'", optopt);
+			usage();
+			break;
+		}
+
+	if (optind != argc - 2)
+		usage();
+
+	if (!(file = fopen(argv[optind], "r")))
+		die("could not open temperament file");
+	if (tparse(&t, file, errbuf, sizeof(errbuf)))
+		die("%s", errbuf);
+	fclose(file);
+
+	nnames = ntabsize(&t.notes);
+	names = xmalloc(nnames * sizeof(*names));
+	ntabstorenames(&t.notes, names);
+	ntabsortnames(&t.notes, names, nnames);
+	start = xmalloc(nnames * sizeof(*start));
+	for (i = 0; i < nnames; i++)
+		ntabget(&t.notes, names[i], &start[i]);
+
+	if (!(file = fopen(argv[optind + 1], "r")))
+		die("could not open targets file");
+	targets = readtargets(file, names, nnames, &o.ntargets);
+	fclose(file);
+
+	o.nnotes = nnames;
+	o.fixed = findnote(names, nnames, t.refname);
+	o.start = start;
+	o.targets = targets;
+	o.best = xmalloc(nnames * sizeof(*o.best));
+	elapsed = now();
+	if (optrun(&o))
+		die("optimization failed");
+	elapsed = now() - elapsed;
+	if (verbose)
+		fprintf(stderr, "ttopt: %llu candidates in %.3lf s (%.0lf/s) on %d threads, cost %.4lf\n",
+		    o.nevals, elapsed, o.nevals / elapsed, o.nthreads, o.cost);
+
+	ntabfreenotes(&t.notes);
+	memset(&t.notes, 0, sizeof(t.notes));
+	t.exact = 0; /* the optimized offsets are in cents */
+	for (i = 0; i < nnames; i++)
+		ntabadd(&t.notes, names[i], o.best[i] - o.best[o.fixed]);
+	tnormalize(&t);
+
+	snprintf(desc, sizeof(desc), "Generated by ttopt from %s.", t.name);
+	free(t.desc);
+	t.desc = xstrdup(desc);
+	free(t.src);
+	t.src = NULL;
+	if (name) {
+		free(t.name);
+		t.name = xstrdup(name);
+	}
+	if (tdump(&t, stdout))
+		die("could not write temperament");
+
+	for (i = 0; i < nnames; i++)
+		free(names[i]);
+	free(names);
+	free(start);
+	free(targets);
+	free(o.best);
+	tfreefields(&t);
+	return 0;
+}
@@ -25,6 +25,7 @@
 
 #include "audio.h"
 #include "temperament.h"
+#include "view.h"
 #include "util.h"
 
 #define SAMPRATE 44100
@@ -32,26 +33,26 @@
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: temperatune [-r reference] [-t time] [-v volume] temperament note octave\n");
+	fprintf(stderr, "usage: temperatune [-r reference] [-t time] [-v volume] [-w waveform] temperament note octave\n");
 	exit(2);
 }
 
 static void
-play(double freq, double volume, unsigned int time)
+play(double freq, int wave, double volume, unsigned int time)
 {
-	Sinebuf sb;
+	Wavebuf wb;
 	PaStream *stream;
 	const char *errmsg;
 	PaError err;
 
-	if (sbinit(&sb, freq, SAMPRATE, volume))
+	if (wbinit(&wb, wave, freq, SAMPRATE, volume))
 		die("pitch out of range: %lf Hz", freq);
 	if ((err = Pa_Initialize()) != paNoError) {
 		errmsg = "could not initialize PortAudio: %s";
 		goto FAIL;
 	}
 
-	err = Pa_OpenDefaultStream(&stream, 0, 1, paFloat32, SAMPRATE, paFramesPerBufferUnspecified, sbcallback, &sb);
+	err = Pa_OpenDefaultStream(&stream, 0, 1, paFloat32, SAMPRATE, paFramesPerBufferUnspecified, wbcallback, &wb);
 	if (err != paNoError) {
 		errmsg = "could not open stream: %s";
 		goto FAIL;
@@ -78,18 +79,20 @@ FAIL:
 int
 main(int argc, char *argv[])
 {
-	int opt;
+	int opt, wave;
 	unsigned long time;
 	double volume, freq, refpitch;
 	char *end, errbuf[256];
 	FILE *tfile;
 	Temperament t;
+	Tview v;
 	long octave;
 
 	time = 5;
 	volume = 0.5;
 	refpitch = 0;
-	while ((opt = getopt(argc, argv, ":r:t:v:")) != -1)
+	wave = WSINE;
+	while ((opt = getopt(argc, argv, ":r:t:v:w:")) != -1)
 		switch (opt) {
 		case 'r':
 			errno = 0;
@@ -109,6 +112,10 @@ main(int argc, char *argv[])
 			if (errno != 0 || *end != '\0' || *optarg == '\0' || volume < 0 || volume > 1)
 				die("bad volume: '%s'", optarg);
 			break;
+		case 'w':
+			if ((wave = wbwave(optarg)) < 0)
+				die("bad waveform: '%s'", optarg);
+			break;
 		case ':':
 			fprintf(stderr, "'%c' expects an argument", optopt);
 			usage();
@@ -131,12 +138,14 @@ main(int argc, char *argv[])
 		die("could not open temperament file");
 	if (tparse(&t, tfile, errbuf, sizeof(errbuf)))
 		die("%s", errbuf);
-	if (refpitch > 0)
-		t.refpitch = refpitch;
-	if ((freq = tgetpitch(&t, argv[optind + 1], octave)) < 0)
+	if (tvinit(&v, &t, octave, octave))
+		die("temperament has no notes");
+	if (refpitch > 0 && tvsetpitch(&v, refpitch))
+		die("bad reference pitch");
+	if ((freq = tvpitch(&v, argv[optind + 1], octave)) < 0)
 		die("bad note: '%s'", argv[optind + 1]);
 
-	play(freq, volume, time);
+	play(freq, wave, volume, time);
 
 	return 0;
 }
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "temperament.h"
+#include "pool.h"
+#include "scala.h"
+#include "util.h"
+#include "walk.h"
+
+typedef struct Conv Conv;
+typedef struct Job Job;
+
+struct Job {
+	char *path;
+	char *out; /* output path, without the extension */
+	int failed;
+	char errbuf[256];
+};
+
+struct Conv {
+	Job *jobs;
+	size_t njobs;
+	size_t cap;
+	const char *outdir;
+	const char *kbmpath;
+	int export;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: ttscala [-j threads] [-k keymap] [-o outdir] scale...\n");
+	fprintf(stderr, "       ttscala -x [-j threads] [-o outdir] temperament...\n");
+	exit(2);
+}
+
+static void
+addjob(void *arg, const char *path)
+{
+	Conv *c;
+
+	c = arg;
+	if (c->njobs == c->cap) {
+		c->cap = c->cap ? 2 * c->cap : 64;
+		if (!(c->jobs = realloc(c->jobs, c->cap * sizeof(*c->jobs))))
+			die("realloc: out of memory");
+	}
+	memset(&c->jobs[c->njobs], 0, sizeof(*c->jobs));
+	c->jobs[c->njobs++].path = xstrdup(path);
+}
+
+/* Returns the output path for a file, replacing its extension with ext. */
+static char *
+outpath(const char *outdir, const char *path, const char *ext)
+{
+	const char *base, *dot;
+	char *ret;
+	int len;
+
+	base = (base = strrchr(path, '/')) ? base + 1 : path;
+	len = (dot = strrchr(base, '.')) && dot != base ? dot - base : (int)strlen(base);
+	ret = xmalloc(strlen(outdir) + len + strlen(ext) + 2);
+	sprintf(ret, "%s/%.*s%s", outdir, len, base, ext);
+	return ret;
+}
+
+static int
+cmpjobout(const void *a, const void *b)
+{
+	const Job *ja, *jb;
+	int cmp;
+
+	ja = *(Job *const *)a;
+	jb = *(Job *const *)b;
+	if ((cmp = strcmp(ja->out, jb->out)))
+		return cmp;
+	return ja < jb ? -1 : ja > jb;
+}
+
+/*
+ * Fails every job whose output would overwrite that of an earlier one,
+ * as for files of the same name in different directories, rather than
+ * losing one result and letting two threads write the same file.
+ */
+static void
+checkclashes(Conv *c)
+{
+	Job **sorted;
+	size_t i, first;
+
+	for (i = 0; i < c->njobs; i++)
+		c->jobs[i].out = outpath(c->outdir, c->jobs[i].path, "");
+	sorted = xmalloc((c->njobs ? c->njobs : 1) * sizeof(*sorted));
+	for (i = 0; i < c->njobs; i++)
+		sorted[i] = &c->jobs[i];
+	qsort(sorted, c->njobs, sizeof(*sorted), cmpjobout);
+	for (first = i = 0; i < c->njobs; i++) {
+		if (strcmp(sorted[i]->out, sorted[first]->out)) {
+			first = i;
+			continue;
+		}
+		if (i != first) {
+			sorted[i]->failed = 1;
+			snprintf(sorted[i]->errbuf, sizeof(sorted[i]->errbuf), "output would overwrite that of %s", sorted[first]->path);
+		}
+	}
+	free(sorted);
+}
+
+static int
+writefile(const char *path, Temperament *t, int (*dump)(Temperament *, FILE *))
+{
+	FILE *output;
+	int retval;
+
+	if (!(output = fopen(path, "w")))
+		return 1;
+	retval = dump(t, output);
+	if (fclose(output))
+		retval = 1;
+	return retval;
+}
+
+static int
+importscl(Conv *c, Job *job)
+{
+	FILE *scl, *kbm;
+	Temperament t;
+	char *out, *base;
+	int retval;
+
+	if (!(scl = fopen(job->path, "r"))) {
+		snprintf(job->errbuf, sizeof(job->errbuf), "%s", strerror(errno));
+		return 1;
+	}
+	kbm = NULL;
+	if (c->kbmpath && !(kbm = fopen(c->kbmpath, "r"))) {
+		snprintf(job->errbuf, sizeof(job->errbuf), "%s: %s", c->kbmpath, strerror(errno));
+		fclose(scl);
+		return 1;
+	}
+	retval = sclparse(&t, scl, kbm, job->errbuf, sizeof(job->errbuf));
+	fclose(scl);
+	if (kbm)
+		fclose(kbm);
+	if (retval)
+		return 1;
+
+	base = (base = strrchr(job->path, '/')) ? base + 1 : job->path;
+	if (!*t.name) {
+		free(t.name);
+		t.name = xstrdup(base);
+	}
+	t.src = xstrdup(base);
+
+	out = outpath(c->outdir, job->path, ".json");
+	if ((retval = writefile(out, &t, tdump)))
+		snprintf(job->errbuf, sizeof(job->errbuf), "could not write %s", out);
+	free(out);
+	tfreefields(&t);
+	return retval;
+}
+
+static int
+exportscl(Conv *c, Job *job)
+{
+	FILE *input;
+	Temperament t;
+	char *out;
+	int retval;
+
+	if (!(input = fopen(job->path, "r"))) {
+		snprintf(job->errbuf, sizeof(job->errbuf), "%s", strerror(errno));
+		return 1;
+	}
+	retval = tparse(&t, input, job->errbuf, sizeof(job->errbuf));
+	fclose(input);
+	if (retval)
+		return 1;
+
+	out = outpath(c->outdir, job->path, ".scl");
+	if ((retval = writefile(out, &t, scldump)))
+		snprintf(job->errbuf, sizeof(job->errbuf), "could not write %s", out);
+	free(out);
+	if (!retval) {
+		out = outpath(c->outdir, job->path, ".kbm");
+		if ((retval = writefile(out, &t, kbmdump)))
+			snprintf(job->errbuf, sizeof(job->errbuf), "could not write %s (is the reference note outside the MIDI range?)", out);
+		free(out);
+	}
+	tfreefields(&t);
+	return retval;
+}
+
+static void
+convert(void *arg, int worker, size_t i)
+{
+	Conv *c;
+
+	USED(worker);
+	c = arg;
+	if (c->jobs[i].failed)
+		return;
+	if (c->export)
+		c->jobs[i].failed = exportscl(c, &c->jobs[i]);
+	else
+		c->jobs[i].failed = importscl(c, &c->jobs[i]);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int opt, nthreads;
+	long l;
+	size_t i, nfailed;
+	char *end;
+	Conv c;
+
+	memset(&c, 0, sizeof(c));
+	c.outdir = ".";
+	if ((l = sysconf(_SC_NPROCESSORS_ONLN)) < 1 || l > INT_MAX)
+		l = 1;
+	nthreads = l;
+	while ((opt = getopt(argc, argv, ":j:k:o:x")) != -1)
+		switch (opt) {
+		case 'j':
+			errno = 0;
+			l = strtol(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0' || l < 1 || l > INT_MAX)
+				die("bad thread count: '%s'", optarg);
+			nthreads = l;
+			break;
+		case 'k':
+			c.kbmpath = optarg;
+			break;
+		case 'o':
+			c.outdir = optarg;
+			break;
+		case 'x':
+			c.export = 1;
+			break;
+		case ':':
+			fprintf(stderr, "'%c' expects an argument", optopt);
+			usage();
+			break;
+		case '?':
+			fprintf(stderr, "unknown option '%c'", optopt);
+			usage();
+			break;
+		}
+
+	if (optind == argc || (c.export && c.kbmpath))
+		usage();
+	for (; optind < argc; optind++)
+		walk(argv[optind], c.export ? ".json" : ".scl", addjob, &c);
+	checkclashes(&c);
+
+	poolrun(nthreads, c.njobs, convert, &c);
+
+	nfailed = 0;
+	for (i = 0; i < c.njobs; i++) {
+		if (c.jobs[i].failed) {
+			printf("%s: %s\n", c.jobs[i].path, c.jobs[i].errbuf);
+			nfailed++;
+		}
+		free(c.jobs[i].path);
+		free(c.jobs[i].out);
+	}
+	free(c.jobs);
+	fprintf(stderr, "ttscala: converted %zu of %zu files\n", c.njobs - nfailed, c.njobs);
+	return nfailed ? 1 : 0;
+}
@@ -22,6 +22,29 @@
 
 #include "util.h"
 
+static void *(*mallocfn)(size_t) = malloc;
+static void (*freefn)(void *) = free;
+
+/*
+ * The library is built with TTBUILD and must never exit, so it leaves out
+ * everything that dies on failure.
+ */
+#ifndef TTBUILD
+/* Writes a string to standard output as a quoted JSON string. */
+void
+jsonstr(const char *s)
+{
+	putchar('"');
+	for (; *s; s++)
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			printf("\\u%04x", *s);
+		else
+			putchar(*s);
+	putchar('"');
+}
+
 void
 die(const char *fmt, ...)
 {
@@ -42,7 +65,7 @@ xmalloc(size_t sz)
 {
 	void *ret;
 
-	if (!(ret = malloc(sz)))
+	if (!(ret = umalloc(sz)))
 		die("xmalloc: out of memory");
 	return ret;
 }
@@ -51,16 +74,52 @@ void *xcalloc(size_t n, size_t sz)
 {
 	void *ret;
 
-	if (!(ret = calloc(n, sz)))
+	if (sz != 0 && n > (size_t)-1 / sz)
 		die("xcalloc: out of memory");
-	return ret;
+	if (!(ret = umalloc(n * sz)))
+		die("xcalloc: out of memory");
+	return memset(ret, 0, n * sz);
 }
 
 char *xstrdup(const char *s)
 {
 	char *ret;
 
-	if (!(ret = strdup(s)))
+	if (!(ret = ustrdup(s)))
 		die("xstrdup: out of memory");
 	return ret;
 }
+#endif
+
+/* Replaces malloc and free for every later allocation. */
+void
+setalloc(void *(*m)(size_t), void (*f)(void *))
+{
+	mallocfn = m;
+	freefn = f;
+}
+
+void *
+umalloc(size_t sz)
+{
+	return mallocfn(sz ? sz : 1);
+}
+
+void
+ufree(void *p)
+{
+	if (p)
+		freefn(p);
+}
+
+char *
+ustrdup(const char *s)
+{
+	char *ret;
+	size_t len;
+
+	len = strlen(s) + 1;
+	if ((ret = umalloc(len)))
+		memcpy(ret, s, len);
+	return ret;
+}
@@ -17,6 +17,18 @@
 #define USED(x) ((void)(x))
 
 void die(const char *fmt, ...);
+void jsonstr(const char *s);
 void *xmalloc(size_t sz);
 void *xcalloc(size_t n, size_t sz);
 char *xstrdup(const char *s);
+
+/*
+ * Allocation through the hooks set with setalloc, returning NULL on
+ * failure rather than exiting. The x functions above use the same hooks.
+ * Only the library sets them; the tools keep malloc and free, so they may
+ * still release memory with free.
+ */
+void setalloc(void *(*mallocfn)(size_t), void (*freefn)(void *));
+void *umalloc(size_t sz);
+void ufree(void *p);
+char *ustrdup(const char *s);
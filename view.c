@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "temperament.h"
+#include "view.h"
+#include "util.h"
+
+static void scale(double *restrict dst, const double *restrict src, size_t n, double k);
+static int tvbuild(Tview *v);
+
+/*
+ * Returns the frequency of a degree in an octave, or -1 if it is out of
+ * range or the table cannot be built.
+ */
+double
+tvfreq(Tview *v, size_t degree, int octave)
+{
+	const double *freq;
+
+	if (!(freq = tvtable(v)))
+		return -1;
+	if (degree >= v->nnotes || octave < v->lowoctave || octave > v->highoctave)
+		return -1;
+	return freq[(size_t)((long)octave - v->lowoctave) * v->nnotes + degree];
+}
+
+void
+tvfree(Tview *v)
+{
+	ufree(v->names);
+	ufree(v->ratios);
+	ufree(v->freq);
+}
+
+/*
+ * Sets up a view of the octaves from lowoctave to highoctave at the
+ * temperament's own reference pitch. Nothing is computed until the first
+ * access.
+ */
+int
+tvinit(Tview *v, Temperament *t, int lowoctave, int highoctave)
+{
+	size_t noctaves;
+
+	memset(v, 0, sizeof(*v));
+	if (lowoctave > highoctave || (v->nnotes = ntabsize(&t->notes)) == 0)
+		return 1;
+	noctaves = (size_t)((long)highoctave - lowoctave) + 1;
+	if (noctaves > SIZE_MAX / sizeof(double) / v->nnotes)
+		return 1;
+	v->size = noctaves * v->nnotes;
+	v->t = t;
+	v->refpitch = t->refpitch;
+	v->freqpitch = NAN;
+	v->lowoctave = lowoctave;
+	v->highoctave = highoctave;
+	return 0;
+}
+
+/*
+ * Returns the frequency of a note in an octave, or -1 if there is none.
+ * Building the table records each note's degree, so the name is looked up
+ * only once.
+ */
+double
+tvpitch(Tview *v, const char *note, int octave)
+{
+	Note *n;
+
+	if (!tvtable(v) || !(n = ntablookup(&v->t->notes, note)))
+		return -1;
+	return tvfreq(v, n->degree, octave);
+}
+
+/*
+ * Changes the reference pitch, in Hz. Pitches that are not finite and
+ * positive are refused, since every frequency would then be too.
+ */
+int
+tvsetpitch(Tview *v, double refpitch)
+{
+	if (!(refpitch > 0) || isinf(refpitch))
+		return 1;
+	v->refpitch = refpitch;
+	return 0;
+}
+
+/*
+ * Returns the whole table, bringing it up to date with the reference pitch,
+ * or NULL if out of memory.
+ */
+const double *
+tvtable(Tview *v)
+{
+	if (!v->ratios && tvbuild(v))
+		return NULL;
+	/* NAN is unequal to every pitch, so a table never scaled always is. */
+	if (v->freqpitch != v->refpitch) {
+		scale(v->freq, v->ratios, v->size, v->refpitch);
+		v->freqpitch = v->refpitch;
+	}
+	return v->freq;
+}
+
+/* Written so that compilers can vectorize it. */
+static void
+scale(double *restrict dst, const double *restrict src, size_t n, double k)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = src[i] * k;
+}
+
+static int
+tvbuild(Tview *v)
+{
+	double *offsets;
+	size_t deg, i;
+	long oct;
+
+	if (!v->names && !(v->names = umalloc(v->nnotes * sizeof(*v->names))))
+		return 1;
+	if (!v->freq && !(v->freq = umalloc(v->size * sizeof(*v->freq))))
+		return 1;
+	if (!(offsets = umalloc(v->nnotes * sizeof(*offsets))))
+		return 1;
+	if (!(v->ratios = umalloc(v->size * sizeof(*v->ratios)))) {
+		ufree(offsets);
+		return 1;
+	}
+	tdegrees(v->t, v->names);
+	for (deg = 0; deg < v->nnotes; deg++)
+		ntabget(&v->t->notes, v->names[deg], &offsets[deg]);
+
+	for (i = 0; i < v->size; i++) {
+		deg = i % v->nnotes;
+		oct = v->lowoctave + (long)(i / v->nnotes);
+		v->ratios[i] = exp2(offsets[deg] / OCTAVE_CENTS + (oct - v->t->refoctave));
+	}
+	v->freqpitch = NAN;
+	ufree(offsets);
+	return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+typedef struct Tview Tview;
+
+/*
+ * The frequency of every note of a temperament in a range of octaves, at
+ * a reference pitch that can be changed cheaply. The table is built on
+ * first access: one exp2 per entry gives each frequency relative to the
+ * reference pitch, and those ratios are kept. Changing only the reference
+ * pitch then costs a single multiplication pass over the ratios. The
+ * temperament must not change while the view is in use.
+ */
+struct Tview {
+	Temperament *t;
+	double refpitch; /* in Hz */
+	int lowoctave, highoctave; /* inclusive */
+	size_t nnotes; /* notes per octave */
+	size_t size; /* entries in the table */
+	char **names; /* note names, in ascending order of pitch from the octave base */
+	double *ratios; /* frequencies at a reference pitch of 1 Hz */
+	double *freq; /* octave-major, indexed by (octave - lowoctave) * nnotes + degree */
+	double freqpitch; /* reference pitch freq was computed for, or NAN if none */
+};
+
+double tvfreq(Tview *v, size_t degree, int octave);
+void tvfree(Tview *v);
+int tvinit(Tview *v, Temperament *t, int lowoctave, int highoctave);
+double tvpitch(Tview *v, const char *note, int octave);
+int tvsetpitch(Tview *v, double refpitch);
+const double *tvtable(Tview *v);
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 Ian Johnson
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "walk.h"
+#include "util.h"
+
+static int cmpstr(const void *a, const void *b);
+static int hassuffix(const char *s, const char *suffix);
+static void walkdir(const char *path, const char *suffix, void (*fn)(void *arg, const char *path), void *arg, int top);
+
+/*
+ * Calls fn(arg, file) for path itself if it is not a directory, or else
+ * for every file ending in suffix under it, in sorted order so that the
+ * result does not depend on the file system. Hidden entries are skipped,
+ * and symbolic links inside a directory are never followed into another
+ * directory, so a link loop cannot make the walk endless. A directory
+ * that cannot be read is passed to fn, which will fail to open it.
+ */
+void
+walk(const char *path, const char *suffix, void (*fn)(void *arg, const char *path), void *arg)
+{
+	walkdir(path, suffix, fn, arg, 1);
+}
+
+static int
+cmpstr(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int
+hassuffix(const char *s, const char *suffix)
+{
+	size_t len, slen;
+
+	len = strlen(s);
+	slen = strlen(suffix);
+	return len >= slen && !strcmp(s + len - slen, suffix);
+}
+
+static void
+walkdir(const char *path, const char *suffix, void (*fn)(void *arg, const char *path), void *arg, int top)
+{
+	struct stat st;
+	DIR *dir;
+	struct dirent *ent;
+	char **names, *sub;
+	size_t nnames, cap, i;
+
+	/* Only a path given at the top may be a link to a directory. */
+	if ((top ? stat(path, &st) : lstat(path, &st)) || !S_ISDIR(st.st_mode)) {
+		if (top || hassuffix(path, suffix))
+			fn(arg, path);
+		return;
+	}
+
+	if (!(dir = opendir(path))) {
+		fn(arg, path);
+		return;
+	}
+	names = NULL;
+	nnames = cap = 0;
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		if (nnames == cap) {
+			cap = cap ? 2 * cap : 64;
+			if (!(names = realloc(names, cap * sizeof(*names))))
+				die("realloc: out of memory");
+		}
+		names[nnames++] = xstrdup(ent->d_name);
+	}
+	closedir(dir);
+	qsort(names, nnames, sizeof(*names), cmpstr);
+
+	for (i = 0; i < nnames; i++) {
+		sub = xmalloc(strlen(path) + strlen(names[i]) + 2);
+		sprintf(sub, "%s/%s", path, names[i]);
+		walkdir(sub, suffix, fn, arg, 0);
+		free(sub);
+		free(names[i]);
+	}
+	free(names);
+}